@@ -3,6 +3,7 @@
 #include "FWCore/Framework/interface/Event.h"
 #include "FWCore/MessageLogger/interface/MessageLogger.h"
 #include "FWCore/Utilities/interface/InputTag.h"
+#include "FWCore/Utilities/interface/Exception.h"
 
 #include "DataFormats/HepMCCandidate/interface/GenParticle.h"
 #include "DataFormats/PatCandidates/interface/PackedGenParticle.h"
@@ -11,9 +12,46 @@
 #include "DataFormats/Math/interface/deltaR.h"
 #include "PandaProd/Auxiliary/interface/PackedValuesExposer.h"
 #include <vector>
+#include <unordered_map>
+#include <functional>
 
 #include "HepPDT/ParticleID.hh"
 
+//! Integer content of a packed gen particle. A pruned particle and a packed particle are the same if their keys are equal.
+struct PackedGenKey
+{
+  PackedGenKey(pat::PackedGenParticle const& part)
+  {
+    PackedGenParticleExposer exposed(part);
+    pdgId = part.pdgId();
+    pt = exposed.packedPt();
+    y = exposed.packedY();
+    phi = exposed.packedPhi();
+    m = exposed.packedM();
+  }
+
+  bool operator==(PackedGenKey const& rhs) const
+  {
+    return pdgId == rhs.pdgId && pt == rhs.pt && y == rhs.y && phi == rhs.phi && m == rhs.m;
+  }
+
+  int pdgId;
+  uint16_t pt;
+  uint16_t y;
+  uint16_t phi;
+  uint16_t m;
+};
+
+struct PackedGenKeyHash
+{
+  size_t operator()(PackedGenKey const& key) const
+  {
+    unsigned long long packed((static_cast<unsigned long long>(key.pt) << 48) | (static_cast<unsigned long long>(key.y) << 32) |
+                              (static_cast<unsigned long long>(key.phi) << 16) | key.m);
+    return std::hash<unsigned long long>()(packed ^ (static_cast<unsigned long long>(key.pdgId) * 0x9e3779b97f4a7c15ULL));
+  }
+};
+
 class MergedGenProducer : public edm::stream::EDProducer<>
 {
  public:
@@ -49,34 +87,46 @@ void MergedGenProducer::produce(edm::Event& event, const edm::EventSetup& setup)
   edm::Handle<edm::View<pat::PackedGenParticle> > packed_handle;
   event.getByToken(input_packed_, packed_handle);
 
+  // Map each pruned particle to its index in the vector, by key in the pruned product.
+  // This index will be the same in the merged collection.
+  // Mothers and daughters of pruned and packed particles are refs to the pruned product.
+  edm::ProductID pruned_id;
+  std::vector<int> pruned_idx;
+  for (unsigned int i = 0; i < pruned_handle->size(); ++i) {
+    auto pr_ref = pruned_handle->refAt(i);
+    if (i == 0) pruned_id = pr_ref.id();
+    if (pr_ref.key() >= pruned_idx.size()) pruned_idx.resize(pr_ref.key() + 1, -1);
+    pruned_idx[pr_ref.key()] = i;
+  }
+
+  auto prunedIndex = [&pruned_id, &pruned_idx](reco::GenParticleRef const& gen_ref) -> unsigned {
+    if (gen_ref.id() != pruned_id || gen_ref.key() >= pruned_idx.size() || pruned_idx[gen_ref.key()] < 0)
+      throw cms::Exception("MergedGenProducer") << "Reference to a particle not in the pruned collection";
+    return pruned_idx[gen_ref.key()];
+  };
+
   // First determine which packed particles are also still in the pruned collection
-  // so that we can skip them later
-  // std::map<reco::GenParticle const*, pat::PackedGenParticle const*> st1_dup_map;
-  std::map<pat::PackedGenParticle const*, reco::GenParticle const*> st1_dup_map;
+  // so that we can skip them later. The packed integer values are compared through a hash.
+  std::unordered_multimap<PackedGenKey, unsigned, PackedGenKeyHash> packed_keys;
+  packed_keys.reserve(packed_handle->size());
+  for (unsigned j = 0; j < packed_handle->size(); ++j)
+    packed_keys.emplace(PackedGenKey(packed_handle->at(j)), j);
+
+  std::vector<bool> st1_dup(packed_handle->size(), false);
+  unsigned n_st1_dup = 0;
 
-  // Also map pointers in the original pruned collection to their index in the vector.
-  // This index will be the same in the merged collection.
-  std::map<reco::Candidate const*, std::size_t> pruned_idx_map;
   for (unsigned int i = 0; i < pruned_handle->size(); ++i) {
     reco::GenParticle const& pr = pruned_handle->at(i);
-    pruned_idx_map[&pr] = i;
     if (pr.status() != 1) continue;
 
     unsigned found_matches = 0;
-    for (unsigned j = 0; j < packed_handle->size(); ++j) {
-      // Compare explicitly the integral values of the packed dudes
-      pat::PackedGenParticle const& pk = packed_handle->at(j);
-      pat::PackedGenParticle packedPruned(pr);
-      PackedGenParticleExposer exposedPacked(pk), exposedPackedPruned(packedPruned);
-      if (
-        pr.pdgId() != pk.pdgId()  
-        || exposedPacked.packedPt()!=exposedPackedPruned.packedPt()
-        || exposedPacked.packedY()!=exposedPackedPruned.packedY()
-        || exposedPacked.packedPhi()!=exposedPackedPruned.packedPhi()
-        || exposedPacked.packedM()!=exposedPackedPruned.packedM()
-      ) continue;
+    auto range = packed_keys.equal_range(PackedGenKey(pat::PackedGenParticle(pr)));
+    for (auto itr = range.first; itr != range.second; ++itr) {
       ++found_matches;
-      st1_dup_map[&pk] = &pr;
+      if (!st1_dup[itr->second]) {
+        st1_dup[itr->second] = true;
+        ++n_st1_dup;
+      }
     }
     if (found_matches > 1) {
       edm::LogWarning("MergedGenProducer") << "Found multiple packed matches for: " << i << "\t" << pr.pdgId() << "\t" << pr.pt() << "\t" << pr.y() << "\n";
@@ -95,7 +145,7 @@ void MergedGenProducer::produce(edm::Event& event, const edm::EventSetup& setup)
   }
 
   // At this point we know what the size of the merged GenParticle will be so we can create it
-  const unsigned int n = pruned_handle->size() + (packed_handle->size() - st1_dup_map.size()) + nPhotonsFromPrunedHadron;
+  const unsigned int n = pruned_handle->size() + (packed_handle->size() - n_st1_dup) + nPhotonsFromPrunedHadron;
   auto cands = std::unique_ptr<reco::GenParticleCollection>(new reco::GenParticleCollection(n));
 
   // First copy in all the pruned candidates
@@ -107,17 +157,17 @@ void MergedGenProducer::produce(edm::Event& event, const edm::EventSetup& setup)
     new_cand.resetMothers(ref.id());
     new_cand.resetDaughters(ref.id());
     for (unsigned m = 0; m < old_cand.numberOfMothers(); ++m) {
-      new_cand.addMother(reco::GenParticleRef(ref, pruned_idx_map.at(old_cand.mother(m))));
+      new_cand.addMother(reco::GenParticleRef(ref, prunedIndex(old_cand.motherRef(m))));
     }
     for (unsigned d = 0; d < old_cand.numberOfDaughters(); ++d) {
-      new_cand.addDaughter(reco::GenParticleRef(ref, pruned_idx_map.at(old_cand.daughter(d))));
+      new_cand.addDaughter(reco::GenParticleRef(ref, prunedIndex(old_cand.daughterRef(d))));
     }
   }
 
   // Now copy in the packed candidates that are not already in the pruned
   for (unsigned i = 0, idx = pruned_handle->size(); i < packed_handle->size(); ++i) {
     pat::PackedGenParticle const& pk = packed_handle->at(i);
-    if (st1_dup_map.count(&pk)) continue;
+    if (st1_dup[i]) continue;
     reco::GenParticle & new_cand = cands->at(idx);
     new_cand = reco::GenParticle(pk.charge(), pk.p4(), pk.vertex(), pk.pdgId(), 1, true);
 
@@ -141,13 +191,15 @@ void MergedGenProducer::produce(edm::Event& event, const edm::EventSetup& setup)
     // Connect to mother from pruned particles
     reco::GenParticle & daughter = cands->at(idx);
     for (unsigned m = 0; m < pk.numberOfMothers(); ++m) {
-      daughter.addMother(reco::GenParticleRef(ref, pruned_idx_map.at(pk.mother(m))));
+      // packed particles have at most one mother
+      unsigned mother_idx = prunedIndex(pk.motherRef());
+      daughter.addMother(reco::GenParticleRef(ref, mother_idx));
       // Since the packed candidates drop the vertex position we'll take this from the mother
       if (m == 0) {
         daughter.setVertex(pk.mother(m)->vertex());
       }
       // Should then add this GenParticle as a daughter of its mother
-      cands->at(pruned_idx_map.at(pk.mother(m))).addDaughter(reco::GenParticleRef(ref, idx));
+      cands->at(mother_idx).addDaughter(reco::GenParticleRef(ref, idx));
     }
     ++idx;
   }
@@ -0,0 +1,40 @@
+#ifndef PandaProd_Producer_AsyncTreeWriter_h
+#define PandaProd_Producer_AsyncTreeWriter_h
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <exception>
+
+//! Runs output jobs (TTree::Fill of the events tree) on a dedicated thread
+/*!
+ * At most one job is in flight. submit() returns immediately unless the previous job is still running,
+ * in which case it blocks (back-pressure). The owner must call wait() before touching anything the job
+ * reads (the panda::Event and any buffer bound to the tree) or writing anything else to the same TFile.
+ * Exceptions thrown by a job are rethrown from the next wait() or submit().
+ */
+class AsyncTreeWriter {
+ public:
+  AsyncTreeWriter();
+  ~AsyncTreeWriter();
+  AsyncTreeWriter(AsyncTreeWriter const&) = delete;
+  AsyncTreeWriter& operator=(AsyncTreeWriter const&) = delete;
+
+  void submit(std::function<void()> const&);
+  void wait();
+
+ private:
+  void run_();
+  void rethrow_();
+
+  std::mutex mutex_{};
+  std::condition_variable cv_{};
+  std::function<void()> job_{};
+  bool busy_{false};
+  bool stop_{false};
+  std::exception_ptr exception_{};
+  std::thread thread_;
+};
+
+#endif
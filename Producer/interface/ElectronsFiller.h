@@ -27,6 +27,7 @@ class ElectronsFiller : public FillerBase {
   void branchNames(panda::utils::BranchList& eventBranches, panda::utils::BranchList&) const override;
   void fill(panda::Event&, edm::Event const&, edm::EventSetup const&) override;
   void setRefs(ObjectMapStore const&) override;
+  void declareAccess(FillerAccess& fillAccess, FillerAccess& setRefsAccess) const override;
 
  protected:
   typedef edm::View<reco::Vertex> VertexView;
@@ -41,7 +42,6 @@ class ElectronsFiller : public FillerBase {
   NamedToken<GsfElectronView> regressionElectronsToken_;
   NamedToken<PhotonView> photonsToken_;
   NamedToken<reco::ConversionCollection> conversionsToken_;
-  NamedToken<reco::CandidateView> pfCandidatesToken_;
   NamedToken<EcalRecHitCollection> ebHitsToken_;
   NamedToken<EcalRecHitCollection> eeHitsToken_;
   NamedToken<reco::BeamSpot> beamSpotToken_;
@@ -0,0 +1,131 @@
+#ifndef PandaProd_Producer_EtaPhiGrid_h
+#define PandaProd_Producer_EtaPhiGrid_h
+
+#include <vector>
+#include <algorithm>
+
+//! Bins a set of (eta, phi) points into a uniform eta-phi grid for fast cone searches
+/*!
+ * Points are stored by cell in a compressed (offset + index) layout. Eta beyond +-maxEta falls into the
+ * outermost rows, and phi wraps around. A cone query visits only the cells overlapping the cone, and
+ * reports the points within dR (inclusive) together with their dR^2. The grid is meant to be refilled
+ * every event; clear() keeps the memory of the previous event. forEachNear() and findNear() use an internal
+ * buffer and are not reentrant; the other queries can be called concurrently on a built grid.
+ */
+class EtaPhiGrid {
+ public:
+  //! cellSize should be of the order of the typical query radius
+  EtaPhiGrid(double cellSize = 0.4, double maxEta = 5.);
+
+  void clear();
+  //! Points are referred to in queries by their order of addition
+  void add(double eta, double phi);
+  //! Build the cell index. Must be called after the last add() and before queries.
+  void build();
+
+  unsigned size() const { return eta_.size(); }
+
+  //! Call f(index, dR2) for each point within dR of (eta, phi), in the order of addition
+  template<class F>
+  void forEachNear(double eta, double phi, double dR, F&& f) const;
+  //! Same as forEachNear but in no particular order. Reentrant and safe to call concurrently.
+  template<class F>
+  void forEachNearUnordered(double eta, double phi, double dR, F&& f) const;
+  //! Indices of the points within dR of (eta, phi), in the order of addition
+  void findNear(double eta, double phi, double dR, std::vector<unsigned>& result) const;
+  //! Lowest index with distance strictly below dR (same as a linear scan breaking at the first match), or -1
+  int findFirst(double eta, double phi, double dR) const;
+  //! Index of the closest point with distance strictly below dR (lowest index on ties), or -1
+  int findClosest(double eta, double phi, double dR) const { return findClosest(eta, phi, dR, [](unsigned) { return true; }); }
+  //! findClosest among the points for which accept(index) is true
+  template<class P>
+  int findClosest(double eta, double phi, double dR, P&& accept) const;
+
+ private:
+  unsigned etaBin_(double) const;
+  unsigned phiBin_(double) const;
+  static double deltaPhi_(double, double);
+
+  double const cellSize_;
+  double const maxEta_;
+  unsigned const nEta_;
+  unsigned const nPhi_;
+  std::vector<double> eta_{};
+  std::vector<double> phi_{};
+  std::vector<unsigned> cells_{}; //!< cell index of each point
+  std::vector<unsigned> offsets_{}; //!< points of cell c are indices_[offsets_[c]:offsets_[c+1]]
+  std::vector<unsigned> indices_{};
+  mutable std::vector<unsigned> candidates_{};
+};
+
+template<class F>
+void
+EtaPhiGrid::forEachNearUnordered(double _eta, double _phi, double _dR, F&& _f) const
+{
+  unsigned etaLow(etaBin_(_eta - _dR));
+  unsigned etaHigh(etaBin_(_eta + _dR));
+
+  // number of phi bins touched by the cone; all of them if the cone wraps onto itself
+  int phiSpan(int(_dR / (6.283185307179586 / nPhi_)) + 1);
+  int phiCenter(phiBin_(_phi));
+  int phiLow(phiCenter - phiSpan);
+  int phiHigh(phiCenter + phiSpan);
+  if (phiHigh - phiLow + 1 >= int(nPhi_)) {
+    phiLow = 0;
+    phiHigh = nPhi_ - 1;
+  }
+
+  double dR2max(_dR * _dR);
+
+  for (unsigned iEta(etaLow); iEta <= etaHigh; ++iEta) {
+    for (int iPhi(phiLow); iPhi <= phiHigh; ++iPhi) {
+      unsigned cell(iEta * nPhi_ + (iPhi + nPhi_) % nPhi_);
+      for (unsigned iO(offsets_[cell]); iO != offsets_[cell + 1]; ++iO) {
+        unsigned idx(indices_[iO]);
+        double dEta(eta_[idx] - _eta);
+        double dPhi(deltaPhi_(phi_[idx], _phi));
+        double dR2(dEta * dEta + dPhi * dPhi);
+        if (dR2 <= dR2max)
+          _f(idx, dR2);
+      }
+    }
+  }
+}
+
+template<class F>
+void
+EtaPhiGrid::forEachNear(double _eta, double _phi, double _dR, F&& _f) const
+{
+  std::vector<unsigned>& found(candidates_);
+  found.clear();
+
+  forEachNearUnordered(_eta, _phi, _dR, [&found](unsigned idx, double) { found.push_back(idx); });
+
+  // cells are visited in grid order; callers usually want the input order
+  std::sort(found.begin(), found.end());
+
+  for (unsigned idx : found) {
+    double dEta(eta_[idx] - _eta);
+    double dPhi(deltaPhi_(phi_[idx], _phi));
+    _f(idx, dEta * dEta + dPhi * dPhi);
+  }
+}
+
+template<class P>
+int
+EtaPhiGrid::findClosest(double _eta, double _phi, double _dR, P&& _accept) const
+{
+  double minDR2(_dR * _dR);
+  int closest(-1);
+  forEachNearUnordered(_eta, _phi, _dR, [&minDR2, &closest, &_accept](unsigned idx, double dR2) {
+      if (dR2 < minDR2 || (closest >= 0 && dR2 == minDR2 && int(idx) < closest)) {
+        if (!_accept(idx))
+          return;
+        minDR2 = dR2;
+        closest = idx;
+      }
+    });
+  return closest;
+}
+
+#endif
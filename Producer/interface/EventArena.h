@@ -0,0 +1,89 @@
+#ifndef PandaProd_Producer_EventArena_h
+#define PandaProd_Producer_EventArena_h
+
+#include <vector>
+#include <map>
+#include <memory>
+#include <utility>
+#include <functional>
+#include <cstddef>
+#include <new>
+
+//! Monotonic memory pool for per-event scratch data of a filler
+/*!
+ * allocate() carves memory out of a few large blocks and deallocation is a no-op. All memory is released
+ * at once by reset(), which PandaProducer calls after the event is written. Blocks are kept across events
+ * and coalesced into one on reset, so that in a steady state no call to the system allocator is made.
+ * Destructors of objects created in the arena are not run by reset(); objects owning heap memory must be
+ * destroyed explicitly.
+ * Not thread-safe: each filler has its own arena.
+ */
+class EventArena {
+ public:
+  EventArena(size_t blockSize = 1 << 16) : blockSize_(blockSize) {}
+  ~EventArena();
+  EventArena(EventArena const&) = delete;
+  EventArena& operator=(EventArena const&) = delete;
+
+  void* allocate(size_t bytes, size_t alignment = alignof(std::max_align_t));
+  //! Release everything allocated since the last reset
+  void reset();
+
+  //! Construct an object in the arena
+  template<class T, class... Args>
+  T* make(Args&&... args) { return new (allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...); }
+
+  //! Number of allocate() calls since construction
+  unsigned long long nAllocations() const { return nAllocations_; }
+  //! Number of blocks requested from the system allocator since construction
+  unsigned long long nBlockAllocations() const { return nBlockAllocations_; }
+
+ private:
+  struct Block {
+    char* data;
+    size_t size;
+  };
+
+  void addBlock_(size_t);
+
+  size_t const blockSize_;
+  std::vector<Block> blocks_{};
+  unsigned current_{0};
+  size_t offset_{0};
+  size_t used_{0}; //!< Bytes used in the blocks before current_
+
+  unsigned long long nAllocations_{0};
+  unsigned long long nBlockAllocations_{0};
+};
+
+//! STL allocator drawing from an EventArena
+template<class T>
+class ArenaAllocator {
+ public:
+  typedef T value_type;
+
+  ArenaAllocator(EventArena& arena) : arena_(&arena) {}
+  template<class U>
+  ArenaAllocator(ArenaAllocator<U> const& other) : arena_(other.arena()) {}
+
+  T* allocate(size_t n) { return static_cast<T*>(arena_->allocate(n * sizeof(T), alignof(T))); }
+  void deallocate(T*, size_t) {}
+
+  EventArena* arena() const { return arena_; }
+
+ private:
+  EventArena* arena_;
+};
+
+template<class T, class U>
+bool operator==(ArenaAllocator<T> const& a1, ArenaAllocator<U> const& a2) { return a1.arena() == a2.arena(); }
+template<class T, class U>
+bool operator!=(ArenaAllocator<T> const& a1, ArenaAllocator<U> const& a2) { return a1.arena() != a2.arena(); }
+
+template<class T>
+using ArenaVector = std::vector<T, ArenaAllocator<T>>;
+
+template<class K, class V, class Compare = std::less<K>>
+using ArenaMap = std::map<K, V, Compare, ArenaAllocator<std::pair<K const, V>>>;
+
+#endif
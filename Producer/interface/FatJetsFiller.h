@@ -2,6 +2,7 @@
 #define PandaProd_Producer_FatJetsFiller_h
 
 #include "JetsFiller.h"
+#include "EtaPhiGrid.h"
 
 #include "DataFormats/BTauReco/interface/JetTag.h"
 #include "PandaProd/Utilities/interface/HEPTopTaggerWrapperV2.h"
@@ -18,15 +19,19 @@
 #include "fastjet/contrib/MeasureDefinition.hh"
 #include "fastjet/contrib/EnergyCorrelator.hh"
 
+#include "TH1D.h"
+
 class FatJetsFiller : public JetsFiller {
  public:
   FatJetsFiller(std::string const&, edm::ParameterSet const&, edm::ConsumesCollector&);
   ~FatJetsFiller();
 
   void branchNames(panda::utils::BranchList& eventBranches, panda::utils::BranchList&) const override;
+  void addOutput(TFile&) override;
 
  protected:
   void fillDetails_(panda::Event&, edm::Event const&, edm::EventSetup const&) override;
+  bool passSubstructurePreselection_(pat::Jet const&) const;
 
   NamedToken<JetView> subjetsToken_;
   NamedToken<int> categoriesToken_;
@@ -43,6 +48,24 @@ class FatJetsFiller : public JetsFiller {
   std::string subjetDeepCsvTag_;
   std::string subjetDeepCmvaTag_;
 
+  //! Keys of the fat-jet discriminators in btagIndex_
+  unsigned shallowBBTagKey_{0};
+  unsigned deepBBprobQKey_{0};
+  unsigned deepBBprobHKey_{0};
+  //! Discriminators of the subjets
+  BTagDiscriminatorIndex subjetBTagIndex_{};
+  unsigned subjetBtagKey_{0};
+  unsigned subjetCmvaKey_{0};
+  std::vector<std::pair<unsigned, unsigned>> subjetDeepCsvKeys_{};
+  std::vector<std::pair<unsigned, unsigned>> subjetDeepCmvaKeys_{};
+  //! userFloat names, built once
+  VString njettinessNames_{};
+  std::string sdMassName_{};
+  std::string prunedMassName_{};
+
+  //! Subjets of the current event binned in eta-phi
+  EtaPhiGrid subjetGrid_;
+
   fastjet::GhostedAreaSpec activeArea_;
   fastjet::AreaDefinition areaDef_;
   fastjet::JetDefinition* jetDefCA_{0};
@@ -62,6 +85,31 @@ class FatJetsFiller : public JetsFiller {
   OutSubjetSelector outSubjetSelector_{};
 
   SubstructureComputeMode computeSubstructure_{kNever};
+
+  //! Bits of substructureMask_
+  enum SubstructureQuantity {
+    kECF = 1 << 0,
+    kTauSD = 1 << 1,
+    kHTT = 1 << 2,
+    kAllSubstructure = kECF | kTauSD | kHTT
+  };
+
+  //! OR of SubstructureQuantity; quantities not in the mask are never computed (and their branches are not booked)
+  unsigned substructureMask_{kAllSubstructure};
+  //! Substructure is computed only for the first substructureMaxJets jets that pass the preselection below
+  unsigned substructureMaxJets_{2};
+  double substructureMinPt_{0.};
+  double substructureMinMass_{0.};
+  double substructureMaxEta_{-1.}; //!< negative = no cut
+  //! ECFs are computed from the leading ecfMaxConstituents SoftDrop constituents
+  unsigned ecfMaxConstituents_{100};
+  //! Relative tolerance of the truncated N=4 ECF sum (0 = exact), see pandaecf::Calculator::setTolerance
+  double ecfTolerance_{0.};
+  //! Recluster the constituents with explicit ghosts (ClusterSequenceArea). No stored quantity depends on the
+  //! area, so this is off by default and only useful for comparisons with the ghosted clustering.
+  bool substructureArea_{false};
+  //! log10 of the largest relative ECF truncation error bound of each jet (booked if ecfTolerance_ > 0)
+  TH1D* hECFTruncation_{0};
 };
 
 #endif
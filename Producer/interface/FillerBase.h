@@ -11,18 +11,36 @@
 #include "PandaTree/Objects/interface/Event.h"
 #include "PandaTree/Objects/interface/Run.h"
 #include "ObjectMap.h"
+#include "EventArena.h"
+#include "PFCandidateIndex.h"
+#include "GenParticleIndex.h"
 
 #include "TFile.h"
 
 #include "tbb/concurrent_unordered_map.h"
 
+#include <mutex>
+
 typedef std::vector<std::string> VString;
 typedef std::vector<std::vector<std::string>> VVString;
 
+//! Shared data read and written by a filler in one processing step (fill or setRefs)
+/*!
+ * Entries are names of other fillers (i.e. their ObjectMapStore entries and the panda objects they point to)
+ * or of external resources that are not safe for concurrent use (e.g. "RandomNumberGenerator").
+ */
+struct FillerAccess {
+  VString reads{};
+  VString writes{};
+};
+
 //! Base class for tree fillers
 /*!
  * There is no strict (programmatic) rule on the scope of each Filler. One basic guideline is to
  * define one Filler per object branch (collection etc.) of the Event.
+ * PandaProducer is a stream module and constructs one instance of each Filler per stream. All per-event
+ * state must therefore be kept in member variables; Fillers must not share mutable state through static
+ * or global variables.
  */
 class FillerBase {
  public:
@@ -45,10 +63,26 @@ class FillerBase {
   virtual void fillEndRun(panda::Run&, edm::Run const&, edm::EventSetup const&) {}
   //! Called (indirectly) by CMSSW framework whenever a new product is registered to Event
   virtual void notifyNewProduct(edm::BranchDescription const&, edm::ConsumesCollector&) {}
+  //! Declare shared data accessed in fill() and setRefs() in addition to the filler's own ObjectMap and Event branches.
+  /*!
+   * PandaProducer can run fill() (and setRefs()) of different fillers concurrently. Two calls are ordered only
+   * if one writes what the other reads or writes. The filler's own name counts as written in both steps; event
+   * branches are assumed to be written by a single filler and are not tracked. Override when setRefs() reads or
+   * modifies the output of another filler or when a non-thread-safe resource is used.
+   */
+  virtual void declareAccess(FillerAccess& fillAccess, FillerAccess& setRefsAccess) const {}
 
   std::string const& getName() const { return fillerName_; }
   bool enabled() const { return enabled_; }
   void setObjectMap(FillerObjectMap& map) { objectMap_ = &map; }
+  //! Serialize product retrieval from the edm::Event when fillers run concurrently
+  void setProductMutex(std::mutex* mutex) { productMutex_ = mutex; }
+  //! Scratch memory of the filler, reset by PandaProducer after each event
+  EventArena& getArena() { return arena_; }
+  //! Shared per-event PF candidate index (null if common.pfCandidates is not configured)
+  void setPFCandidateIndex(PFCandidateIndex* index) { pfCandidateIndex_ = index; }
+  //! Shared per-event gen particle index (null if common.genParticles is not configured)
+  void setGenParticleIndex(GenParticleIndex* index) { genParticleIndex_ = index; }
 
  private:
   std::string const fillerName_;
@@ -132,8 +166,18 @@ class FillerBase {
   //! get a product from the Event or Run. Return a null pointer if the product does not exist
   template<class Principal, class Product>
   Product const* getProductSafe_(Principal const&, NamedToken<Product> const&, edm::Handle<Product>* = 0);
+  //! get the PF candidate index of the event, built on first use
+  PFCandidateIndex const& getPFCandidateIndex_(edm::Event const&);
+  //! get the gen particle index of the event, built on first use
+  GenParticleIndex const& getGenParticleIndex_(edm::Event const&);
 
   FillerObjectMap* objectMap_{0};
+  //! edm::Event::getByToken is not safe for concurrent calls within one module
+  std::mutex* productMutex_{0};
+  //! Use for per-event temporary containers (ArenaVector, ArenaMap) in fill() and setRefs()
+  EventArena arena_{};
+  PFCandidateIndex* pfCandidateIndex_{0};
+  GenParticleIndex* genParticleIndex_{0};
 
   bool isRealData_;
   bool useTrigger_;
@@ -201,6 +245,10 @@ FillerBase::getProduct_(Principal const& _prn, NamedToken<Product> const& _token
   if (!handlePtr)
     handlePtr = &handle;
 
+  std::unique_lock<std::mutex> lock;
+  if (productMutex_)
+    lock = std::unique_lock<std::mutex>(*productMutex_);
+
   if (!_prn.getByToken(_token.second, *handlePtr))
     throw cms::Exception("ProductNotFound") << "fillers." << getName() << "." << _token.first;
 
@@ -219,6 +267,10 @@ FillerBase::getProductSafe_(Principal const& _prn, NamedToken<Product> const& _t
   if (!handlePtr)
     handlePtr = &handle;
 
+  std::unique_lock<std::mutex> lock;
+  if (productMutex_)
+    lock = std::unique_lock<std::mutex>(*productMutex_);
+
   if (!_prn.getByToken(_token.second, *handlePtr))
     return 0;
 
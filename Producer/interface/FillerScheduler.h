@@ -0,0 +1,42 @@
+#ifndef PandaProd_Producer_FillerScheduler_h
+#define PandaProd_Producer_FillerScheduler_h
+
+#include "FillerBase.h"
+
+#include <vector>
+#include <functional>
+#include <ostream>
+
+//! Dependency graph of the fillers of one PandaProducer instance
+/*!
+ * Built once from FillerBase::declareAccess. For each step (fill and setRefs),
+ * two fillers are connected if one writes data the other reads or writes. Edges always point from the
+ * filler earlier in the list to the later one, so that the outcome is identical to the sequential execution.
+ * Fillers without a path between them are executed as concurrent TBB tasks.
+ */
+class FillerScheduler {
+ public:
+  enum Step {
+    kFill,
+    kSetRefs,
+    nSteps
+  };
+
+  typedef std::function<void(unsigned)> Task;
+
+  FillerScheduler(std::vector<FillerBase*> const&);
+
+  //! Call task(iF) for all fillers, respecting the dependencies of the step. Exceptions are rethrown.
+  void run(Step, Task const&) const;
+  //! Print the dependencies
+  void print(std::ostream&) const;
+
+ private:
+  std::vector<std::string> names_{};
+  //! Direct successors of each filler
+  std::vector<std::vector<unsigned>> successors_[nSteps];
+  //! Number of direct predecessors of each filler
+  std::vector<unsigned> nPredecessors_[nSteps];
+};
+
+#endif
@@ -14,6 +14,7 @@ class GenJetsFiller : public FillerBase {
   void branchNames(panda::utils::BranchList& eventBranches, panda::utils::BranchList&) const override;
   void fill(panda::Event&, edm::Event const&, edm::EventSetup const&) override;
   void setRefs(ObjectMapStore const&) override;
+  void declareAccess(FillerAccess& fillAccess, FillerAccess& setRefsAccess) const override;
 
  protected:
   typedef edm::View<reco::GenJet> GenJetView;
@@ -21,7 +22,6 @@ class GenJetsFiller : public FillerBase {
   typedef edm::View<reco::GenParticle> GenParticleView;
   typedef edm::Ptr<reco::GenJet> GenJetPtr;
 
-  NamedToken<GenParticleView> genParticlesToken_;
   NamedToken<GenJetView> genJetsToken_;
   NamedToken<reco::JetFlavourInfoMatchingCollection> flavorToken_;
 
@@ -0,0 +1,55 @@
+#ifndef PandaProd_Producer_GenParticleIndex_h
+#define PandaProd_Producer_GenParticleIndex_h
+
+#include "DataFormats/HepMCCandidate/interface/GenParticle.h"
+#include "DataFormats/Common/interface/View.h"
+
+#include "LazyEventIndex.h"
+
+#include <unordered_map>
+#include <cstdint>
+
+//! Per-event lookup of gen particles by value (pdgId, status flags, and p4)
+/*!
+ * Finds the particle in common.genParticles that a copied reco::GenParticle (e.g. the hadron mothers written
+ * by GenHFHadronMatcher) was made from. See LazyEventIndex for ownership, threading, and lifetime.
+ */
+class GenParticleIndex : public LazyEventIndex {
+ public:
+  typedef edm::View<reco::GenParticle> GenParticleView;
+
+  GenParticleIndex(edm::EDGetTokenT<GenParticleView> const& token) : token_(token) {}
+
+  //! Build the index for this event if not done yet
+  GenParticleIndex const& get(edm::Event const& event) { ensureBuilt_(event); return *this; }
+
+  GenParticleView const& particles() const { return *particles_; }
+  edm::Ptr<reco::GenParticle> ptrAt(unsigned i) const { return particles_->ptrAt(i); }
+
+  //! Lowest index of a particle with identical pdgId, status flags, and p4, or -1
+  int find(reco::GenParticle const&) const;
+
+ private:
+  struct Key {
+    Key(reco::GenParticle const&);
+    bool operator==(Key const&) const;
+
+    int pdgId;
+    unsigned long flags;
+    std::uint64_t p4[4];
+  };
+
+  struct KeyHash {
+    std::size_t operator()(Key const&) const;
+  };
+
+  void build_(edm::Event const&) override;
+
+  edm::EDGetTokenT<GenParticleView> const token_;
+
+  GenParticleView const* particles_{0};
+  //! Kept across events to reuse the buckets
+  std::unordered_map<Key, unsigned, KeyHash> index_{};
+};
+
+#endif
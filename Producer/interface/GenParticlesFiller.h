@@ -8,10 +8,12 @@
 
 #include "PandaTree/Objects/interface/UnpackedGenParticle.h"
 
+struct PNodeWithPtr;
+
 class GenParticlesFiller : public FillerBase {
  public:
   GenParticlesFiller(std::string const&, edm::ParameterSet const&, edm::ConsumesCollector&);
-  ~GenParticlesFiller() {}
+  ~GenParticlesFiller();
 
   void branchNames(panda::utils::BranchList& eventBranches, panda::utils::BranchList&) const override;
   void addOutput(TFile&) override;
@@ -28,6 +30,9 @@ class GenParticlesFiller : public FillerBase {
   bool fillPacked_{true};
   bool fillUnpacked_{false};
 
+  //! Decay tree nodes, reused across events (gen particles by view index, then packed particles)
+  std::vector<PNodeWithPtr> nodes_{};
+
   panda::UnpackedGenParticleCollection outUnpacked = panda::UnpackedGenParticleCollection("genParticlesU", 256);
   TTree* outputTree_{0};
 };
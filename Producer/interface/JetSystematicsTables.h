@@ -0,0 +1,62 @@
+#ifndef PandaProd_Producer_JetSystematicsTables_h
+#define PandaProd_Producer_JetSystematicsTables_h
+
+#include <vector>
+
+class JetCorrectorParameters;
+namespace JME {
+  class JetResolutionObject;
+}
+
+//! Flat copy of the JEC "Uncertainty" payload
+/*!
+ * JetCorrectionUncertainty looks the eta bin up and copies the pt grid of the bin on every
+ * getUncertainty() call, and has to be called once per direction. This table holds the same
+ * (JetEta bins) x (JetPt points with up and down values) payload in flat arrays and returns both
+ * directions from one lookup, with the interpolation done in float exactly like
+ * SimpleJetCorrectionUncertainty. set() returns false if the payload is not in this form, in which
+ * case the caller should keep using JetCorrectionUncertainty.
+ */
+class JECUncertaintyTable {
+ public:
+  bool set(JetCorrectorParameters const&);
+  void clear();
+  bool isValid() const { return valid_; }
+
+  //! Relative uncertainties; both are -999 if eta is outside of the binning
+  void get(float eta, float pt, float& up, float& down) const;
+
+ private:
+  std::vector<float> etaMin_{};
+  std::vector<float> etaMax_{};
+  std::vector<unsigned> offsets_{}; //!< points of bin i are [offsets_[i], offsets_[i+1])
+  std::vector<float> pt_{};
+  std::vector<float> up_{};
+  std::vector<float> down_{};
+  bool valid_{false};
+};
+
+//! Flat copy of an eta-binned JER scale factor payload
+/*!
+ * Replaces three JetResolutionScaleFactor::getScaleFactor() calls (each building a record search over
+ * the JetParameters map) with one scan over the eta bins. Bins are inclusive on both edges and the first
+ * matching bin is taken, as in JetResolutionObject::getRecord(). set() returns false if the payload is
+ * binned in anything else than JetEta.
+ */
+class JERScaleFactorTable {
+ public:
+  bool set(JME::JetResolutionObject const&);
+  void clear();
+  bool isValid() const { return valid_; }
+
+  //! All three are 1 if eta is outside of the binning
+  void get(float eta, float& sf, float& sfUp, float& sfDown) const;
+
+ private:
+  std::vector<float> etaMin_{};
+  std::vector<float> etaMax_{};
+  std::vector<float> values_{}; //!< (nominal, down, up) per bin
+  bool valid_{false};
+};
+
+#endif
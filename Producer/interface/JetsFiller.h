@@ -9,10 +9,39 @@
 #include "DataFormats/JetReco/interface/GenJetCollection.h"
 #include "DataFormats/PatCandidates/interface/Jet.h"
 
+#include "JetMETCorrections/Modules/interface/JetResolution.h"
+
+#include "JetSystematicsTables.h"
+#include "EtaPhiGrid.h"
+
 #include <functional>
 
 class JetCorrectionUncertainty;
 
+//! Positions of a fixed list of b-tag discriminators in pat::Jet::getPairDiscri()
+/*!
+ * pat::Jet::bDiscriminator(name) is a linear search with string comparisons. All jets of one product carry
+ * the same discriminators in the same order, so the positions are resolved once and the values are read by
+ * index. update() validates the cached positions against a jet (the first one of each event) and re-resolves
+ * them when the layout has changed. A jet with a different number of discriminators than the validated one
+ * falls back to bDiscriminator(). The lookup follows bDiscriminator(): the last entry with the name is used,
+ * and "" and "default" stand for trackCountingHighEffBJetTags.
+ */
+class BTagDiscriminatorIndex {
+ public:
+  //! Register a discriminator name. Returns the key to pass to get().
+  unsigned add(std::string const&);
+  void update(pat::Jet const&);
+  //! Same as jet.bDiscriminator(name of key)
+  float get(pat::Jet const&, unsigned key) const;
+
+ private:
+  std::vector<std::string> names_{};
+  std::vector<int> positions_{}; //!< -1 if the name is not in the layout
+  unsigned layoutSize_{0};
+  bool resolved_{false};
+};
+
 class JetsFiller : public FillerBase {
  public:
   JetsFiller(std::string const&, edm::ParameterSet const&, edm::ConsumesCollector&);
@@ -21,10 +50,14 @@ class JetsFiller : public FillerBase {
   void branchNames(panda::utils::BranchList& eventBranches, panda::utils::BranchList&) const override;
   void fill(panda::Event&, edm::Event const&, edm::EventSetup const&) override;
   void setRefs(ObjectMapStore const&) override;
+  void declareAccess(FillerAccess& fillAccess, FillerAccess& setRefsAccess) const override;
 
  protected:
   virtual void fillDetails_(panda::Event&, edm::Event const&, edm::EventSetup const&) {}
   void fillDeepBySwitch_(panda::MicroJet&, unsigned int const, float);
+  //! Reload the JEC uncertainty / JER payloads if the IOV has changed
+  void updateJEC_(edm::EventSetup const&);
+  void updateJER_(edm::EventSetup const&);
 
   typedef edm::View<reco::Jet> JetView;
   typedef edm::View<reco::GenJet> GenJetView;
@@ -63,7 +96,28 @@ class JetsFiller : public FillerBase {
 
   std::string puidTag_;
 
+  //! Discriminators of the input jets
+  BTagDiscriminatorIndex btagIndex_{};
+  unsigned csvKey_{0};
+  unsigned cmvaKey_{0};
+  //! (deepSuff, key) for deepCSV and deepCMVA probabilities
+  std::vector<std::pair<unsigned, unsigned>> deepCsvKeys_{};
+  std::vector<std::pair<unsigned, unsigned>> deepCmvaKeys_{};
+
+  //! JEC uncertainty lookup; jecUncertainty_ is used only if the payload does not fit in jecTable_
+  JECUncertaintyTable jecTable_{};
   JetCorrectionUncertainty* jecUncertainty_{0};
+  unsigned long long jecCacheId_{static_cast<unsigned long long>(-1)};
+  //! JER payloads; ptResSF_ is used only if the payload does not fit in jerSFTable_
+  JME::JetResolution ptRes_{};
+  JME::JetResolutionScaleFactor ptResSF_{};
+  JERScaleFactorTable jerSFTable_{};
+  unsigned long long jerCacheId_{static_cast<unsigned long long>(-1)};
+  unsigned long long jerSFCacheId_{static_cast<unsigned long long>(-1)};
+
+  //! Per-event indices of the gen jets and PU-ID jets for the reco jet matching
+  EtaPhiGrid genJetGrid_{};
+  EtaPhiGrid puidJetGrid_{};
 
   typedef std::function<panda::JetCollection&(panda::Event&)> OutputSelector;
 
@@ -0,0 +1,58 @@
+#ifndef PandaProd_Producer_LazyEventIndex_h
+#define PandaProd_Producer_LazyEventIndex_h
+
+#include "FWCore/Framework/interface/Event.h"
+#include "FWCore/Utilities/interface/EDGetToken.h"
+#include "FWCore/Utilities/interface/Exception.h"
+#include "DataFormats/Common/interface/Handle.h"
+
+#include <mutex>
+#include <atomic>
+
+//! Base of the per-event lookup tables shared between fillers (PFCandidateIndex, GenParticleIndex)
+/*!
+ * Owned by PandaProducer (one per stream). The table is built by the first filler asking for it in the event
+ * and invalidated by reset() after the event. Building is thread-safe; once built, the const accessors of the
+ * derived class can be used concurrently by fillers running in parallel.
+ */
+class LazyEventIndex {
+ public:
+  virtual ~LazyEventIndex() {}
+
+  //! The same mutex FillerBase uses for product access when fillers run concurrently
+  void setProductMutex(std::mutex* mutex) { productMutex_ = mutex; }
+  void reset() { built_.store(false, std::memory_order_release); }
+
+ protected:
+  //! Call build_ if not done yet in this event
+  void ensureBuilt_(edm::Event const&);
+  //! Fill the table from the event
+  virtual void build_(edm::Event const&) = 0;
+
+  //! getByToken under the product mutex; throws if the product is missing, naming the configuration parameter
+  template<class Product>
+  Product const& getProduct_(edm::Event const&, edm::EDGetTokenT<Product> const&, char const* paramName);
+
+ private:
+  std::mutex* productMutex_{0};
+  std::mutex buildMutex_{};
+  std::atomic<bool> built_{false};
+};
+
+template<class Product>
+Product const&
+LazyEventIndex::getProduct_(edm::Event const& _event, edm::EDGetTokenT<Product> const& _token, char const* _paramName)
+{
+  edm::Handle<Product> handle;
+
+  std::unique_lock<std::mutex> lock;
+  if (productMutex_)
+    lock = std::unique_lock<std::mutex>(*productMutex_);
+
+  if (!_event.getByToken(_token, handle))
+    throw cms::Exception("ProductNotFound") << _paramName;
+
+  return *handle.product();
+}
+
+#endif
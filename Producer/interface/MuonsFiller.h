@@ -16,6 +16,7 @@ class MuonsFiller : public FillerBase {
   void branchNames(panda::utils::BranchList& eventBranches, panda::utils::BranchList&) const override;
   void fill(panda::Event&, edm::Event const&, edm::EventSetup const&) override;
   void setRefs(ObjectMapStore const&) override;
+  void declareAccess(FillerAccess& fillAccess, FillerAccess& setRefsAccess) const override;
 
  protected:
   typedef edm::View<reco::Muon> MuonView;
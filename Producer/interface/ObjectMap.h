@@ -5,9 +5,14 @@
 #include "PandaTree/Framework/interface/Object.h"
 
 #include <map>
+#include <vector>
+#include <algorithm>
 #include <string>
 #include <tuple>
+#include <utility>
 #include <typeinfo>
+#include <stdexcept>
+#include <cstdint>
 
 //! Abstract base to handle ObjectMaps for different types in a single container
 class ObjectMapBase {
@@ -22,14 +27,74 @@ class ObjectMapBase {
   std::string label;
 };
 
+//! Hash of an edm::Ptr built from (ProductID, key), consistent with edm::Ptr::operator==
+struct EDMPtrHash {
+  template<class T>
+  size_t operator()(edm::Ptr<T> const& ptr) const
+  {
+    uint64_t id((uint64_t(ptr.id().processIndex()) << 16) | ptr.id().productIndex());
+    return mix(ptr.key() ^ (id << 40));
+  }
+
+  static size_t mix(uint64_t x)
+  {
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdULL;
+    x ^= x >> 33;
+    return x;
+  }
+};
+
+//! Hash of a panda object address
+struct PandaPtrHash {
+  template<class T>
+  size_t operator()(T const* ptr) const { return EDMPtrHash::mix(reinterpret_cast<uintptr_t>(ptr)); }
+};
+
+//! Insert-only map stored as a vector of links plus an open-addressing index table
+/*!
+ * Provides the subset of the std::map interface used by the fillers (find, at, count, size, iteration).
+ * Links are iterated in insertion order. clear() keeps the capacity of both vectors, so that no allocation
+ * happens once the largest event of the job has been seen.
+ */
+template<class Key, class Value, class Hash>
+class FlatLinkMap {
+ public:
+  typedef std::pair<Key, Value> value_type;
+  typedef typename std::vector<value_type>::const_iterator const_iterator;
+
+  const_iterator begin() const { return links_.begin(); }
+  const_iterator end() const { return links_.end(); }
+  size_t size() const { return links_.size(); }
+  bool empty() const { return links_.empty(); }
+
+  const_iterator find(Key const&) const;
+  size_t count(Key const& key) const { return find(key) == end() ? 0 : 1; }
+  //! Same as std::map::at, throws std::out_of_range if the key is not found
+  Value const& at(Key const&) const;
+
+  //! Same as std::map::emplace; does not overwrite an existing link
+  bool emplace(Key const&, Value const&);
+  void clear();
+
+ private:
+  //! Slot in table_ holding the key or the empty slot where it would be inserted
+  size_t slot_(Key const&) const;
+  void rehash_(size_t);
+
+  std::vector<value_type> links_{};
+  //! Index into links_ + 1; 0 = empty slot. Size is zero or a power of 2
+  std::vector<unsigned> table_{};
+};
+
 //! Actual EDM <-> panda map
 template<class EDM, class PANDA>
 class ObjectMap : public ObjectMapBase {
   typedef edm::Ptr<EDM> EDMPtr;
 
  public:
-  std::map<EDMPtr, PANDA*> fwdMap;
-  std::map<PANDA*, EDMPtr> bwdMap;
+  FlatLinkMap<EDMPtr, PANDA*, EDMPtrHash> fwdMap;
+  FlatLinkMap<PANDA*, EDMPtr, PandaPtrHash> bwdMap;
 
   void clear() override { fwdMap.clear(); bwdMap.clear(); }
   MapId getId() const override { return MapId(typeid(EDM).hash_code(), typeid(PANDA).hash_code(), label); }
@@ -53,6 +118,89 @@ class FillerObjectMap : public std::map<ObjectMapBase::MapId, ObjectMapBase*> {
 
 typedef std::map<std::string, FillerObjectMap> ObjectMapStore;
 
+template<class Key, class Value, class Hash>
+typename FlatLinkMap<Key, Value, Hash>::const_iterator
+FlatLinkMap<Key, Value, Hash>::find(Key const& _key) const
+{
+  if (table_.empty())
+    return end();
+
+  unsigned idx(table_[slot_(_key)]);
+  if (idx == 0)
+    return end();
+
+  return links_.begin() + (idx - 1);
+}
+
+template<class Key, class Value, class Hash>
+Value const&
+FlatLinkMap<Key, Value, Hash>::at(Key const& _key) const
+{
+  auto itr(find(_key));
+  if (itr == end())
+    throw std::out_of_range("FlatLinkMap::at");
+
+  return itr->second;
+}
+
+template<class Key, class Value, class Hash>
+bool
+FlatLinkMap<Key, Value, Hash>::emplace(Key const& _key, Value const& _value)
+{
+  // keep the load factor below 1/2
+  if (2 * (links_.size() + 1) > table_.size())
+    rehash_(table_.empty() ? 64 : 2 * table_.size());
+
+  unsigned& idx(table_[slot_(_key)]);
+  if (idx != 0)
+    return false;
+
+  links_.emplace_back(_key, _value);
+  idx = links_.size();
+
+  return true;
+}
+
+template<class Key, class Value, class Hash>
+void
+FlatLinkMap<Key, Value, Hash>::clear()
+{
+  if (links_.empty())
+    return;
+
+  links_.clear();
+  std::fill(table_.begin(), table_.end(), 0);
+}
+
+template<class Key, class Value, class Hash>
+size_t
+FlatLinkMap<Key, Value, Hash>::slot_(Key const& _key) const
+{
+  size_t mask(table_.size() - 1);
+  size_t slot(Hash()(_key) & mask);
+
+  // linear probing
+  while (table_[slot] != 0 && !(links_[table_[slot] - 1].first == _key))
+    slot = (slot + 1) & mask;
+
+  return slot;
+}
+
+template<class Key, class Value, class Hash>
+void
+FlatLinkMap<Key, Value, Hash>::rehash_(size_t _size)
+{
+  table_.assign(_size, 0);
+
+  size_t mask(_size - 1);
+  for (unsigned iL(0); iL != links_.size(); ++iL) {
+    size_t slot(Hash()(links_[iL].first) & mask);
+    while (table_[slot] != 0)
+      slot = (slot + 1) & mask;
+    table_[slot] = iL + 1;
+  }
+}
+
 template<class EDM, class PANDA>
 ObjectMap<EDM, PANDA>&
 FillerObjectMap::get(std::string label/* = ""*/)
@@ -0,0 +1,59 @@
+#ifndef PandaProd_Producer_PFCandidateIndex_h
+#define PandaProd_Producer_PFCandidateIndex_h
+
+#include "DataFormats/Candidate/interface/Candidate.h"
+#include "DataFormats/Common/interface/View.h"
+
+#include "LazyEventIndex.h"
+#include "EtaPhiGrid.h"
+
+#include <vector>
+
+//! Per-event columnar copy of the PF candidates with an eta-phi grid for cone queries
+/*!
+ * Built from common.pfCandidates; see LazyEventIndex for ownership, threading, and lifetime. Besides the
+ * accessors, the reentrant grid queries (findClosest, forEachNearUnordered) can be used concurrently.
+ * Candidate indices are the indices in the edm::View.
+ */
+class PFCandidateIndex : public LazyEventIndex {
+ public:
+  PFCandidateIndex(edm::EDGetTokenT<reco::CandidateView> const& token) : token_(token) {}
+
+  //! Build the index for this event if not done yet
+  PFCandidateIndex const& get(edm::Event const& event) { ensureBuilt_(event); return *this; }
+
+  unsigned size() const { return pt_.size(); }
+  reco::CandidateView const& candidates() const { return *candidates_; }
+  reco::CandidatePtr ptrAt(unsigned i) const { return candidates_->ptrAt(i); }
+
+  double pt(unsigned i) const { return pt_[i]; }
+  double eta(unsigned i) const { return eta_[i]; }
+  double phi(unsigned i) const { return phi_[i]; }
+  double px(unsigned i) const { return px_[i]; }
+  double py(unsigned i) const { return py_[i]; }
+  int pdgId(unsigned i) const { return pdgId_[i]; }
+  int charge(unsigned i) const { return charge_[i]; }
+  //! Key of the associated vertex (packed candidates only), -1 if none
+  int vertexKey(unsigned i) const { return vertexKey_[i]; }
+
+  EtaPhiGrid const& grid() const { return grid_; }
+
+ private:
+  void build_(edm::Event const&) override;
+
+  edm::EDGetTokenT<reco::CandidateView> const token_;
+
+  reco::CandidateView const* candidates_{0};
+  std::vector<double> pt_{};
+  std::vector<double> eta_{};
+  std::vector<double> phi_{};
+  std::vector<double> px_{};
+  std::vector<double> py_{};
+  std::vector<int> pdgId_{};
+  std::vector<int> charge_{};
+  std::vector<int> vertexKey_{};
+  //! Queries are typically isolation-type cones of 0.1 - 0.4
+  EtaPhiGrid grid_{0.1};
+};
+
+#endif
@@ -6,6 +6,9 @@
 #include "DataFormats/Candidate/interface/CandidateFwd.h"
 #include "DataFormats/VertexReco/interface/VertexFwd.h"
 #include "DataFormats/Common/interface/ValueMap.h"
+#include "DataFormats/Provenance/interface/ProductID.h"
+
+#include <unordered_map>
 
 class PFCandsFiller : public FillerBase {
  public:
@@ -15,12 +18,21 @@ class PFCandsFiller : public FillerBase {
   void branchNames(panda::utils::BranchList& eventBranches, panda::utils::BranchList&) const override;
   void fill(panda::Event&, edm::Event const&, edm::EventSetup const&) override;
   void setRefs(ObjectMapStore const&) override;
+  void declareAccess(FillerAccess& fillAccess, FillerAccess& setRefsAccess) const override;
 
  protected:
   typedef edm::ValueMap<reco::CandidatePtr> CandidatePtrMap;
   typedef edm::View<reco::Vertex> VertexView;
   typedef edm::Ptr<reco::Vertex> VertexPtr;
 
+  //! Build the (product, key) -> inCands index lookup
+  void indexCandidates_(ArenaVector<reco::CandidatePtr> const&);
+  //! Index in inCands of the candidate pointed to, or -1
+  int findCandidate_(reco::CandidatePtr const&) const;
+  //! Fill puppiPtrs (aligned with inCands) from a puppi ValueMap keyed by the puppi input
+  void mapPuppi_(edm::Event const&, NamedToken<CandidatePtrMap> const&, NamedToken<reco::CandidateView> const&, ArenaVector<reco::CandidatePtr>& puppiPtrs, char const* name);
+  static unsigned long long ptrHash_(reco::CandidatePtr const&);
+
   NamedToken<reco::CandidateView> candidatesToken_;
   NamedToken<CandidatePtrMap> puppiMapToken_;
   NamedToken<reco::CandidateView> puppiInputToken_;
@@ -30,6 +42,13 @@ class PFCandsFiller : public FillerBase {
 
   bool useExistingWeights_{true};
 
+  //! inCands lookup, kept across events to reuse the memory
+  //! keyToIndex_ is used when all candidates come from one product, ptrToIndex_ otherwise
+  edm::ProductID pfProductID_{};
+  bool singleProduct_{true};
+  std::vector<int> keyToIndex_{};
+  std::unordered_map<unsigned long long, unsigned> ptrToIndex_{};
+
   //! cache the candidate and vertex ordering (using ref keys) to use in setRefs
   panda::PFCandCollection* outCandidates_{};
   std::vector<VertexPtr> orderedVertices_{};
@@ -23,6 +23,7 @@ class PhotonsFiller : public FillerBase {
   void branchNames(panda::utils::BranchList& eventBranches, panda::utils::BranchList&) const override;
   void fill(panda::Event&, edm::Event const&, edm::EventSetup const&) override;
   void setRefs(ObjectMapStore const&) override;
+  void declareAccess(FillerAccess& fillAccess, FillerAccess& setRefsAccess) const override;
 
  protected:
   typedef edm::View<reco::Photon> PhotonView;
@@ -33,7 +34,6 @@ class PhotonsFiller : public FillerBase {
   NamedToken<PhotonView> photonsToken_;
   NamedToken<PhotonView> smearedPhotonsToken_;
   NamedToken<PhotonView> regressionPhotonsToken_;
-  NamedToken<reco::CandidateView> pfCandidatesToken_;
   NamedToken<EcalRecHitCollection> ebHitsToken_;
   NamedToken<EcalRecHitCollection> eeHitsToken_;
   NamedToken<BoolMap> looseIdToken_;
@@ -0,0 +1,63 @@
+#ifndef PandaProd_Producer_TimingReport_h
+#define PandaProd_Producer_TimingReport_h
+
+#include "TDirectory.h"
+
+#include <vector>
+#include <string>
+#include <ostream>
+
+//! Latency distributions of the processing steps of PandaProducer
+/*!
+ * A step is a (name, phase) pair, e.g. (jets, fill) or (PandaProducer, treeFill). Each step keeps a histogram
+ * of the per-event wall-clock latency with logarithmic bins, the sum, and the exact maximum together with the
+ * event in which it occurred. Each stream fills its own report; the reports are merged at the end of the job
+ * and written out as histograms and a summary tree with percentiles (and optionally as JSON).
+ */
+class TimingReport {
+ public:
+  struct EventId {
+    unsigned run{0};
+    unsigned lumi{0};
+    unsigned long long event{0};
+  };
+
+  //! Logarithmic binning from minMS to maxMS; under- and overflow are kept in the first and last bins
+  static unsigned const nBins{160};
+  static double constexpr minMS{1.e-3};
+  static double constexpr maxMS{1.e5};
+
+  //! Register a step and return its index
+  unsigned addStep(std::string const& name, std::string const& phase);
+  unsigned nSteps() const { return steps_.size(); }
+
+  //! Record one measurement. Different steps can be filled concurrently.
+  void fill(unsigned step, double ms, EventId const&);
+  //! Add the counts of another report with an identical list of steps
+  void merge(TimingReport const&);
+
+  //! Approximate quantile (interpolated within a bin), in ms
+  double quantile(unsigned step, double q) const;
+
+  //! Write one TH1D per step into a "timing" subdirectory and a "timingSummary" tree
+  void write(TDirectory&) const;
+  //! Write the summary as a JSON array
+  void writeJSON(std::ostream&) const;
+
+ private:
+  struct Step {
+    std::string name;
+    std::string phase;
+    std::vector<unsigned long long> counts;
+    unsigned long long n{0};
+    double sum{0.};
+    double max{0.};
+    EventId maxEvent{};
+  };
+
+  static double binLowEdge_(unsigned);
+
+  std::vector<Step> steps_{};
+};
+
+#endif
@@ -0,0 +1,57 @@
+#ifndef PandaProd_Producer_TraceRecorder_h
+#define PandaProd_Producer_TraceRecorder_h
+
+#include <vector>
+#include <string>
+#include <mutex>
+#include <chrono>
+#include <ostream>
+
+//! Timeline of PandaProducer steps in the Chrome trace event format
+/*!
+ * Each record is a complete ("ph": "X") event with begin time and duration. Records carry a process id
+ * (0 for job-level transitions, stream index + 1 for stream-level steps) and the index of the thread that
+ * executed them, so that the trace viewer (chrome://tracing, ui.perfetto.dev) shows one track per thread
+ * under each stream. record() is thread-safe.
+ */
+class TraceRecorder {
+ public:
+  typedef std::chrono::steady_clock Clock;
+
+  TraceRecorder(unsigned pid) : pid_(pid) {}
+  TraceRecorder(TraceRecorder const&) = delete;
+
+  //! Record a step. run, lumi, event are written as args when nonzero.
+  void record(std::string const& name, char const* category, Clock::time_point begin, Clock::time_point end,
+              unsigned run = 0, unsigned lumi = 0, unsigned long long event = 0);
+
+  //! Move all records of another recorder into this one
+  void absorb(TraceRecorder&);
+
+  unsigned long long size() const { return records_.size(); }
+
+  //! Write the records as a Chrome trace JSON. Timestamps are relative to the earliest record.
+  void writeJSON(std::ostream&) const;
+
+  //! Small integer id of the calling thread, stable for the lifetime of the thread
+  static unsigned threadIndex();
+
+ private:
+  struct Record {
+    std::string name;
+    char const* category;
+    Clock::time_point begin;
+    Clock::duration duration;
+    unsigned pid;
+    unsigned tid;
+    unsigned run;
+    unsigned lumi;
+    unsigned long long event;
+  };
+
+  unsigned const pid_;
+  std::mutex mutex_{};
+  std::vector<Record> records_{};
+};
+
+#endif
@@ -26,22 +26,24 @@ class WeightsFiller : public FillerBase {
   void addOutput(TFile&) override;
   void fillAll(edm::Event const&, edm::EventSetup const&) override;
   void fill(panda::Event&, edm::Event const&, edm::EventSetup const&) override;
-  void fillEndRun(panda::Run&, edm::Run const&, edm::EventSetup const&) override;
+  void fillBeginRun(panda::Run&, edm::Run const&, edm::EventSetup const&) override;
   void notifyNewProduct(edm::BranchDescription const&, edm::ConsumesCollector&) override;
 
  protected:
   void getLHEWeights_(LHEEventProduct const&);
+  //! Signal reweight ids (non-integer ids) listed in the initrwgt header of the LHE run product
+  std::vector<TString> getSignalWeightIds_(LHERunInfoProduct const&) const;
   void bookGenParam_();
 
   NamedToken<GenEventInfoProduct> genInfoToken_;
   NamedToken<LHEEventProduct> lheEventToken_;
+  NamedToken<LHERunInfoProduct> lheRunToken_;
 
-  // learn the size of the signal weights vector in the first 100 events
-  static unsigned const learningPhase{100};
-  
+  // The signal weights vector is booked from the run header of the first run, before any event is filled.
+  // Every stream sees the same header, so all stream outputs have the same genParam layout.
   std::vector<TString> wids_{};
-  float genParamBuffer_[learningPhase][panda::GenReweight::NMAX]{};
-  unsigned bufferCounter_{0};
+  bool genParamBooked_{false};
+  bool unlistedWeightWarned_{false};
 
   unsigned pdfBegin_{0};
   unsigned pdfEnd_{0};
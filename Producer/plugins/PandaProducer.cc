@@ -1,9 +1,11 @@
-#include "FWCore/Framework/interface/one/EDAnalyzer.h"
+#include "FWCore/Framework/interface/stream/EDAnalyzer.h"
 #include "FWCore/Framework/interface/Run.h"
 #include "FWCore/Framework/interface/LuminosityBlock.h"
 #include "FWCore/Framework/interface/Event.h"
 #include "FWCore/Framework/interface/MakerMacros.h"
 #include "FWCore/Utilities/interface/InputTag.h"
+#include "FWCore/Utilities/interface/StreamID.h"
+#include "FWCore/Utilities/interface/Exception.h"
 #include "FWCore/Common/interface/TriggerNames.h"
 #include "DataFormats/Common/interface/TriggerResults.h"
 #include "DataFormats/Common/interface/Handle.h"
@@ -11,14 +13,38 @@
 #include "PandaTree/Objects/interface/Event.h"
 
 #include "../interface/FillerBase.h"
+#include "../interface/FillerScheduler.h"
+#include "../interface/TimingReport.h"
+#include "../interface/TraceRecorder.h"
+#include "../interface/AsyncTreeWriter.h"
 #include "../interface/ObjectMap.h"
+#include "../interface/PFCandidateIndex.h"
+#include "../interface/GenParticleIndex.h"
 
 #include "TFile.h"
 #include "TTree.h"
 #include "TH1D.h"
+#include "TKey.h"
+#include "TBranch.h"
+#include "TLeaf.h"
+#include "TClass.h"
+#include "TFileMerger.h"
+#include "TTreeIndex.h"
+#include "RVersion.h"
+#include "TString.h"
 #include <vector>
+#include <map>
+#include <set>
+#include <algorithm>
+#include <mutex>
+#include <memory>
 #include <utility>
+#include <functional>
 #include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <iomanip>
+#include <fstream>
 
 typedef std::chrono::steady_clock SClock;
 double toMS(SClock::duration const& interval)
@@ -26,60 +52,236 @@ double toMS(SClock::duration const& interval)
   return std::chrono::duration_cast<std::chrono::nanoseconds>(interval).count() * 1.e-6;
 }
 
-class PandaProducer : public edm::one::EDAnalyzer<edm::one::SharedResources, edm::one::WatchRuns, edm::one::WatchLuminosityBlocks> {
+//! Job-wide state shared by all stream instances of PandaProducer
+/*!
+ * Each stream writes its own output file. The stream files are merged into outputName at the end of
+ * the job. Quantities that cannot be reconstructed from the stream files (luminosity block summary, timers)
+ * are accumulated here. Members are only modified under the mutex.
+ */
+struct PandaProducerGlobal {
+  PandaProducerGlobal(edm::ParameterSet const& _cfg) :
+    outputName(_cfg.getUntrackedParameter<std::string>("outputFile", "panda.root")),
+    printLevel(_cfg.getUntrackedParameter<unsigned>("printLevel", 0)),
+    timingJSON(_cfg.getUntrackedParameter<std::string>("timingJSON", "")),
+    traceFile(_cfg.getUntrackedParameter<std::string>("traceFile", "")),
+    compressionSettings(getCompressionSettings(_cfg)),
+    branchSizeReport(_cfg.getUntrackedParameter<bool>("branchSizeReport", false))
+  {
+    if (!traceFile.empty())
+      trace.reset(new TraceRecorder(0));
+  }
+
+  //! ROOT compression settings (100 * algorithm + level) from compressionAlgorithm and compressionLevel; -1 = ROOT default
+  static int getCompressionSettings(edm::ParameterSet const&);
+
+  struct LumiSummary {
+    unsigned runNumber;
+    unsigned lumiNumber;
+    unsigned nEvents;
+  };
+
+  std::string const outputName;
+  unsigned const printLevel;
+  std::string const timingJSON;
+  std::string const traceFile;
+  int const compressionSettings;
+  bool const branchSizeReport;
+
+  mutable std::mutex mutex{};
+  //! Stream index -> stream output file name
+  mutable std::map<unsigned, std::string> streamOutputs{};
+  //! Number of events per luminosity block, summed over streams, in the order of global endLuminosityBlock
+  mutable std::vector<LumiSummary> lumiSummaries{};
+  //! Filler timers summed over streams. The last entry is for the CMSSW execution outside of this module
+  mutable std::vector<std::string> timerNames{};
+  mutable std::vector<SClock::duration> timers{};
+  //! Filler scratch allocations (EventArena::allocate calls) and the resulting system allocations, summed over streams
+  mutable std::vector<unsigned long long> scratchAllocations{};
+  mutable std::vector<unsigned long long> scratchBlockAllocations{};
+  //! Latency distributions merged over streams (null unless timingReport = True)
+  mutable std::unique_ptr<TimingReport> timing{};
+  //! Job-level transitions; stream timelines are absorbed at endStream (null unless traceFile is set)
+  mutable std::unique_ptr<TraceRecorder> trace{};
+  mutable unsigned long long nEvents{0};
+  mutable unsigned long long nOtherSteps{0};
+};
+
+/*static*/
+int
+PandaProducerGlobal::getCompressionSettings(edm::ParameterSet const& _cfg)
+{
+  // algorithm codes of ROOT::ECompressionAlgorithm / ROOT::RCompressionSetting::EAlgorithm, and the level
+  // ROOT uses for each algorithm by default (ROOT::RCompressionSetting::EDefaults)
+  std::map<std::string, std::pair<int, int>> const algorithms{
+    {"ZLIB", {1, 1}},
+    {"LZMA", {2, 7}},
+    {"LZ4", {4, 4}},
+    {"ZSTD", {5, 5}}
+  };
+
+  auto algoName(_cfg.getUntrackedParameter<std::string>("compressionAlgorithm", ""));
+  int level(_cfg.getUntrackedParameter<int>("compressionLevel", -1));
+
+  if (algoName.empty()) {
+    if (level < 0)
+      return -1;
+    algoName = "ZLIB";
+  }
+
+  auto aItr(algorithms.find(algoName));
+  if (aItr == algorithms.end())
+    throw edm::Exception(edm::errors::Configuration, "PandaProducer")
+      << "Unknown compressionAlgorithm " << algoName << " (valid: ZLIB, LZMA, LZ4, ZSTD)";
+
+#if ROOT_VERSION_CODE < ROOT_VERSION(6, 20, 0)
+  // ZSTD support was added in ROOT 6.20; older versions do not recognize algorithm 5
+  if (algoName == "ZSTD")
+    throw edm::Exception(edm::errors::Configuration, "PandaProducer")
+      << "compressionAlgorithm ZSTD requires ROOT 6.20 or later (this release has ROOT " << ROOT_RELEASE << ")";
+#endif
+
+  if (level < 0)
+    level = aItr->second.second;
+  if (level > 9)
+    throw edm::Exception(edm::errors::Configuration, "PandaProducer")
+      << "compressionLevel must be between 0 and 9";
+
+  return aItr->second.first * 100 + level;
+}
+
+class PandaProducer : public edm::stream::EDAnalyzer<edm::GlobalCache<PandaProducerGlobal>, edm::LuminosityBlockSummaryCache<unsigned>> {
 public:
-  explicit PandaProducer(edm::ParameterSet const&);
+  explicit PandaProducer(edm::ParameterSet const&, PandaProducerGlobal const*);
   ~PandaProducer();
 
+  static std::unique_ptr<PandaProducerGlobal> initializeGlobalCache(edm::ParameterSet const&);
+  static void globalEndJob(PandaProducerGlobal*);
+
+  static std::shared_ptr<unsigned> globalBeginLuminosityBlockSummary(edm::LuminosityBlock const&, edm::EventSetup const&, LuminosityBlockContext const*);
+  static void globalEndLuminosityBlockSummary(edm::LuminosityBlock const&, edm::EventSetup const&, LuminosityBlockContext const*, unsigned*);
+
 private:
   void analyze(edm::Event const&, edm::EventSetup const&) override;
   void beginRun(edm::Run const&, edm::EventSetup const&) override;
   void endRun(edm::Run const&, edm::EventSetup const&) override;
   void beginLuminosityBlock(edm::LuminosityBlock const&, edm::EventSetup const&) override;
-  void endLuminosityBlock(edm::LuminosityBlock const&, edm::EventSetup const&) override;
-  void beginJob() override;
-  void endJob() override;
+  void endLuminosityBlockSummary(edm::LuminosityBlock const&, edm::EventSetup const&, unsigned*) const override;
+  void beginStream(edm::StreamID) override;
+  void endStream() override;
+
+  //! Call fill() or setRefs() of all fillers, concurrently if parallelFillers is set
+  void runStep_(FillerScheduler::Step, std::function<void(FillerBase&)> const&);
+  //! Release the per-event scratch memory of all fillers and invalidate the PF candidate index
+  void resetArenas_();
+  //! Finish the timing and tracing of an event
+  void endEventTiming_(SClock::time_point analyzeStart);
+  //! Apply basket size and AutoFlush settings to the events tree
+  void configureEventTree_();
+  //! TTree::Fill of the events tree; runs on the writer thread if asyncOutput = True
+  void fillEventTree_();
+  //! Block until the pending asynchronous TTree::Fill (if any) is done
+  void waitOutput_() { if (writer_) writer_->wait(); }
+
+  //! Index of the TimingReport step for filler iF in the given phase
+  unsigned timingStep_(unsigned iF, unsigned phase) const { return iF * nFillerPhases + phase; }
+
+  enum FillerPhase {
+    kFillAll,
+    kFill,
+    kSetRefs,
+    nFillerPhases
+  };
+
+  //! Merge the per-stream files into the job output
+  //! The merged events tree is sorted by (runNumber, lumiNumber, eventNumber)
+  static void mergeStreamOutputs_(std::vector<std::string> const& inputs, std::string const& output, int compressionSettings);
+  //! Throw if the stream files differ in their objects, events branches or histogram binnings
+  static void checkStreamOutputs_(std::vector<std::string> const& inputs);
+  //! Print the compressed and uncompressed size of each top-level branch of the events tree
+  static void printBranchSizes_(TTree&);
 
   std::vector<FillerBase*> fillers_;
   ObjectMapStore objectMaps_;
+  std::unique_ptr<FillerScheduler> scheduler_{}; //! Null unless parallelFillers = True
+  std::mutex productMutex_{};
+  std::unique_ptr<PFCandidateIndex> pfCandidateIndex_{}; //! Null unless fillers.common.pfCandidates is set
+  std::unique_ptr<GenParticleIndex> genParticleIndex_{}; //! Null unless fillers.common.genParticles is set
 
   VString const selectEvents_;
   edm::EDGetTokenT<edm::TriggerResults> const skimResultsToken_;
 
+  std::string outputName_{}; //! Output file of this stream
   TFile* outputFile_{0};
   TTree* eventTree_{0};
   TTree* runTree_{0};
-  TTree* lumiSummaryTree_{0};
   TH1D* eventCounter_{0};
   panda::Event outEvent_;
 
   unsigned nEventsInLumi_;
 
-  std::string const outputName_;
   bool const useTrigger_;
   unsigned const printLevel_;
+  bool const parallelFillers_;
+  //! Time the steps (printLevel >= 1, timingReport = True, or traceFile set)
+  bool const measureTime_;
+  //! Trace only the first traceMaxEvents events of each stream (0 = all)
+  unsigned const traceMaxEvents_;
+
+  //! Basket size for all branches of the events tree (0 = ROOT default)
+  int const basketSize_;
+  //! "branch:size" pairs; branch names may contain wildcards
+  VString const branchBasketSizes_;
+  //! Argument to TTree::SetAutoFlush (0 = ROOT default)
+  long long const autoFlush_;
+  //! Call TTree::OptimizeBaskets after this number of entries in the events tree (0 = never)
+  unsigned const optimizeBasketsAfter_;
+  bool const asyncOutput_;
+  std::unique_ptr<AsyncTreeWriter> writer_{}; //! Null unless asyncOutput = True
 
   std::vector<SClock::duration> timers_;
+  std::unique_ptr<TimingReport> timing_{}; //! Null unless timingReport = True
+  std::unique_ptr<TraceRecorder> trace_{}; //! Null unless traceFile is set
+  bool traceEvent_{false}; //! Current event is traced
+  TimingReport::EventId eventId_{};
   SClock::time_point lastAnalyze_; //! Time point of last return from analyze()
   unsigned long long nEvents_;
 };
 
-PandaProducer::PandaProducer(edm::ParameterSet const& _cfg) :
+PandaProducer::PandaProducer(edm::ParameterSet const& _cfg, PandaProducerGlobal const*) :
   selectEvents_(_cfg.getUntrackedParameter<VString>("SelectEvents")),
   skimResultsToken_(consumes<edm::TriggerResults>(edm::InputTag("TriggerResults"))), // no process name -> pick up the trigger results from the current process
   outEvent_(),
   nEventsInLumi_(0),
-  outputName_(_cfg.getUntrackedParameter<std::string>("outputFile", "panda.root")),
   useTrigger_(_cfg.getUntrackedParameter<bool>("useTrigger", true)),
   printLevel_(_cfg.getUntrackedParameter<unsigned>("printLevel", 0)),
+  parallelFillers_(_cfg.getUntrackedParameter<bool>("parallelFillers", false)),
+  measureTime_(printLevel_ >= 1 || _cfg.getUntrackedParameter<bool>("timingReport", false) ||
+               !_cfg.getUntrackedParameter<std::string>("traceFile", "").empty()),
+  traceMaxEvents_(_cfg.getUntrackedParameter<unsigned>("traceMaxEvents", 1000)),
+  basketSize_(_cfg.getUntrackedParameter<int>("basketSize", 0)),
+  branchBasketSizes_(_cfg.getUntrackedParameter<VString>("branchBasketSizes", VString())),
+  autoFlush_(_cfg.getUntrackedParameter<long long>("autoFlush", 0)),
+  optimizeBasketsAfter_(_cfg.getUntrackedParameter<unsigned>("optimizeBasketsAfter", 0)),
+  asyncOutput_(_cfg.getUntrackedParameter<bool>("asyncOutput", false)),
   timers_(),
   lastAnalyze_(),
   nEvents_(0)
 {
+  // One instance of this module (and therefore of each filler) is constructed per stream
   auto&& coll(consumesCollector());
 
   auto& fillersCfg(_cfg.getUntrackedParameterSet("fillers"));
 
+  if (fillersCfg.existsAs<edm::ParameterSet>("common", false)) {
+    auto& commonCfg(fillersCfg.getUntrackedParameterSet("common"));
+    auto pfCandidatesTag(commonCfg.getUntrackedParameter<std::string>("pfCandidates", ""));
+    if (!pfCandidatesTag.empty())
+      pfCandidateIndex_.reset(new PFCandidateIndex(coll.consumes<reco::CandidateView>(edm::InputTag(pfCandidatesTag))));
+    auto genParticlesTag(commonCfg.getUntrackedParameter<std::string>("genParticles", ""));
+    if (!genParticlesTag.empty())
+      genParticleIndex_.reset(new GenParticleIndex(coll.consumes<GenParticleIndex::GenParticleView>(edm::InputTag(genParticlesTag))));
+  }
+
   SClock::time_point start;
 
   for (auto& fillerName : fillersCfg.getParameterNames()) {
@@ -94,7 +296,7 @@ PandaProducer::PandaProducer(edm::ParameterSet const& _cfg) :
       auto className(fillerPSet.getUntrackedParameter<std::string>("filler") + "Filler");
 
       if (printLevel_ >= 1) {
-        std::cout << "[PandaProducer::PandaProducer] " 
+        std::cout << "[PandaProducer::PandaProducer] "
           << "Constructing " << className << "::" << fillerName << std::endl;
 
         if (printLevel_ >= 3)
@@ -108,8 +310,10 @@ PandaProducer::PandaProducer(edm::ParameterSet const& _cfg) :
         fillers_.push_back(filler);
 
       filler->setObjectMap(objectMaps_[fillerName]);
+      filler->setPFCandidateIndex(pfCandidateIndex_.get());
+      filler->setGenParticleIndex(genParticleIndex_.get());
 
-      if (printLevel_ >= 1) {
+      if (measureTime_) {
         timers_.push_back(SClock::duration::zero());
 
         if (printLevel_ >= 3)
@@ -117,28 +321,54 @@ PandaProducer::PandaProducer(edm::ParameterSet const& _cfg) :
       }
     }
     catch (std::exception& ex) {
-      std::cerr << "[PandaProducer::PandaProducer] " 
+      std::cerr << "[PandaProducer::PandaProducer] "
         << "Configuration error in " << fillerName << ":"
                                      << ex.what() << std::endl;
       throw;
     }
   }
 
-  if (printLevel_ >= 1) {
+  if (measureTime_) {
     // timer for the CMSSW execution outside of this module
     timers_.push_back(SClock::duration::zero());
   }
 
+  if (_cfg.getUntrackedParameter<bool>("timingReport", false)) {
+    timing_.reset(new TimingReport);
+
+    // step indices follow timingStep_()
+    char const* phaseNames[nFillerPhases] = {"fillAll", "fill", "setRefs"};
+    for (auto* filler : fillers_) {
+      for (unsigned iP(0); iP != nFillerPhases; ++iP)
+        timing_->addStep(filler->getName(), phaseNames[iP]);
+    }
+    timing_->addStep("PandaProducer", "treeFill");
+    timing_->addStep("PandaProducer", "analyze");
+  }
+
+  if (parallelFillers_) {
+    for (auto* filler : fillers_)
+      filler->setProductMutex(&productMutex_);
+    if (pfCandidateIndex_)
+      pfCandidateIndex_->setProductMutex(&productMutex_);
+    if (genParticleIndex_)
+      genParticleIndex_->setProductMutex(&productMutex_);
+
+    scheduler_.reset(new FillerScheduler(fillers_));
+
+    if (printLevel_ >= 2) {
+      std::cout << "[PandaProducer::PandaProducer] "
+        << "Filler dependencies" << std::endl;
+      scheduler_->print(std::cout);
+    }
+  }
+
   // The lambda function inside will be called by CMSSW Framework whenever a new product is registered
   callWhenNewProductsRegistered([this](edm::BranchDescription const& branchDescription) {
       auto&& coll(this->consumesCollector());
       for (auto* filler : this->fillers_)
         filler->notifyNewProduct(branchDescription, coll);
     });
-
-  // Might use some thread-unsafe resource and therefore cannot run concurrently with another edm::one module
-  // This is being super-conservative - can do better by collecting information from the individual fillers.
-  usesResource();
 }
 
 PandaProducer::~PandaProducer()
@@ -147,11 +377,36 @@ PandaProducer::~PandaProducer()
     delete filler;
 }
 
+/*static*/
+std::unique_ptr<PandaProducerGlobal>
+PandaProducer::initializeGlobalCache(edm::ParameterSet const& _cfg)
+{
+  return std::unique_ptr<PandaProducerGlobal>(new PandaProducerGlobal(_cfg));
+}
+
 void
 PandaProducer::analyze(edm::Event const& _event, edm::EventSetup const& _setup)
 {
+  // The previous event may still be in TTree::Fill on the writer thread. It reads outEvent_ and
+  // buffers bound to the events tree by the fillers, so nothing can be filled before it is done.
+  waitOutput_();
+
   eventCounter_->Fill(0.5);
-  
+
+  traceEvent_ = trace_ && (traceMaxEvents_ == 0 || nEvents_ < traceMaxEvents_);
+
+  SClock::time_point analyzeStart;
+  if (timing_ || traceEvent_) {
+    analyzeStart = SClock::now();
+    eventId_.run = _event.id().run();
+    eventId_.lumi = _event.luminosityBlock();
+    eventId_.event = _event.id().event();
+
+    // time between the previous return from analyze() and now is spent in other modules / the framework
+    if (traceEvent_ && nEvents_ != 0)
+      trace_->record("Other CMSSW", "cmssw", lastAnalyze_, analyzeStart);
+  }
+
   if (printLevel_ >= 1) {
     if (nEvents_ == 0) {
       if (printLevel_ >= 3)
@@ -178,29 +433,33 @@ PandaProducer::analyze(edm::Event const& _event, edm::EventSetup const& _setup)
   for (unsigned iF(0); iF != fillers_.size(); ++iF) {
     auto* filler(fillers_[iF]);
     try {
-      if (printLevel_ >= 1) {
-        start = SClock::now();
+      if (printLevel_ >= 2)
+        std::cout << "[PandaProducer::analyze] "
+                  << "Calling " << filler->getName() << "->fillAll()" << std::endl;
 
-        if (printLevel_ >= 2)
-          std::cout << "[PandaProducer::analyze] " 
-                    << "Calling " << filler->getName() << "->fillAll()" << std::endl;
-      }
+      if (measureTime_)
+        start = SClock::now();
 
       filler->fillAll(_event, _setup);
 
-      if (printLevel_ >= 1) {
-        auto dt(SClock::now() - start);
+      if (measureTime_) {
+        auto end(SClock::now());
+        auto dt(end - start);
 
         if (printLevel_ >= 3) {
-          std::cout << "[PandaProducer::analyze] " 
+          std::cout << "[PandaProducer::analyze] "
                     << "Step " << filler->getName() << "->fillAll() took " << toMS(dt) << " ms" << std::endl;
         }
-        
+
         timers_[iF] += dt;
+        if (timing_)
+          timing_->fill(timingStep_(iF, kFillAll), toMS(dt), eventId_);
+        if (traceEvent_)
+          trace_->record(filler->getName(), "fillAll", start, end, eventId_.run, eventId_.lumi, eventId_.event);
       }
     }
     catch (std::exception& ex) {
-      std::cerr << "[PandaProducer::analyze] " 
+      std::cerr << "[PandaProducer::analyze] "
         << "Error in " << filler->getName() << "::fillAll()" << std::endl;
       throw;
     }
@@ -217,8 +476,12 @@ PandaProducer::analyze(edm::Event const& _event, edm::EventSetup const& _setup)
         if (iP != pathNames.size() && triggerResults->accept(iP))
           break;
       }
-      if (iS == selectEvents_.size())
+      if (iS == selectEvents_.size()) {
+        resetArenas_();
+        endEventTiming_(analyzeStart);
+        lastAnalyze_ = SClock::now();
         return;
+      }
     }
   }
 
@@ -235,75 +498,139 @@ PandaProducer::analyze(edm::Event const& _event, edm::EventSetup const& _setup)
   outEvent_.eventNumber = _event.id().event();
   outEvent_.isData = _event.isRealData();
 
-  for (unsigned iF(0); iF != fillers_.size(); ++iF) {
-    auto* filler(fillers_[iF]);
-    try {
-      if (printLevel_ >= 1) {
-        if (printLevel_ >= 2)
-          std::cout << "[PandaProducer::fill] " 
-                    << "Calling " << filler->getName() << "->fill()" << std::endl;
+  runStep_(FillerScheduler::kFill, [this, &_event, &_setup](FillerBase& filler) {
+      filler.fill(this->outEvent_, _event, _setup);
+    });
 
-        start = SClock::now();
-      }
+  // Set inter-branch references
+  runStep_(FillerScheduler::kSetRefs, [this](FillerBase& filler) {
+      filler.setRefs(this->objectMaps_);
+    });
 
-      filler->fill(outEvent_, _event, _setup);
+  if (writer_)
+    writer_->submit([this]() { this->fillEventTree_(); });
+  else
+    fillEventTree_();
 
-      if (printLevel_ >= 1) {
-        auto dt(SClock::now() - start);
+  resetArenas_();
 
-        if (printLevel_ >= 3)
-          std::cout << "[PandaProducer::analyze] " 
-                    << "Step " << filler->getName() << "->fill() took " << toMS(dt) << " ms" << std::endl;
+  endEventTiming_(analyzeStart);
 
-        timers_[iF] += dt;
-      }
-    }
-    catch (std::exception& ex) {
-      std::cerr << "[PandaProducer::fill] " 
-        << "Error in " << filler->getName() << "::fill()" << std::endl;
-      throw;
-    }
+  lastAnalyze_ = SClock::now();
+}
+
+void
+PandaProducer::fillEventTree_()
+{
+  // With asyncOutput, this overlaps with the tail of analyze(). The TTree::Fill timing step is not
+  // touched by anything else, and eventId_ and traceEvent_ only change after waitOutput_().
+  SClock::time_point start;
+  if (timing_ || traceEvent_)
+    start = SClock::now();
+
+  outEvent_.fill(*eventTree_);
+
+  if (optimizeBasketsAfter_ != 0 && eventTree_->GetEntries() == optimizeBasketsAfter_)
+    eventTree_->OptimizeBaskets();
+
+  if (timing_ || traceEvent_) {
+    auto end(SClock::now());
+    if (timing_)
+      timing_->fill(timing_->nSteps() - 2, toMS(end - start), eventId_);
+    if (traceEvent_)
+      trace_->record("TTree::Fill", "output", start, end, eventId_.run, eventId_.lumi, eventId_.event);
   }
+}
 
-  // Set inter-branch references
-  for (unsigned iF(0); iF != fillers_.size(); ++iF) {
-    auto* filler(fillers_[iF]);
-    try {
-      if (printLevel_ >= 1) {
-        if (printLevel_ >= 2)
-          std::cout << "[PandaProducer:fill] "
-                    << "Calling " << filler->getName() << "->setRefs()" << std::endl;
+void
+PandaProducer::endEventTiming_(SClock::time_point _analyzeStart)
+{
+  if (!timing_ && !traceEvent_)
+    return;
 
-        start = SClock::now();
-      }
+  auto end(SClock::now());
+
+  if (timing_)
+    timing_->fill(timing_->nSteps() - 1, toMS(end - _analyzeStart), eventId_);
+  if (traceEvent_)
+    trace_->record("analyze", "event", _analyzeStart, end, eventId_.run, eventId_.lumi, eventId_.event);
+}
 
-      filler->setRefs(objectMaps_);
+void
+PandaProducer::runStep_(FillerScheduler::Step _step, std::function<void(FillerBase&)> const& _call)
+{
+  char const* stepName(_step == FillerScheduler::kFill ? "fill()" : "setRefs()");
+  FillerPhase phase(_step == FillerScheduler::kFill ? kFill : kSetRefs);
 
-      if (printLevel_ >= 1) {
-        auto dt(SClock::now() - start);
+  // timers_[iF] and the timing step of filler iF are only touched by the task of filler iF
+  auto task([this, &_call, stepName, phase](unsigned iF) {
+      auto* filler(this->fillers_[iF]);
+      SClock::time_point start;
 
-        if (printLevel_ >= 3)
-          std::cout << "[PandaProducer::analyze] " 
-                    << "Step " << filler->getName() << "->setRefs() took " << toMS(dt) << " ms" << std::endl;
+      try {
+        if (this->printLevel_ >= 2)
+          std::cout << "[PandaProducer::analyze] "
+                    << "Calling " << filler->getName() << "->" << stepName << std::endl;
 
-        timers_[iF] += dt;
+        if (this->measureTime_)
+          start = SClock::now();
+
+        _call(*filler);
+
+        if (this->measureTime_) {
+          auto end(SClock::now());
+          auto dt(end - start);
+
+          if (this->printLevel_ >= 3)
+            std::cout << "[PandaProducer::analyze] "
+                      << "Step " << filler->getName() << "->" << stepName << " took " << toMS(dt) << " ms" << std::endl;
+
+          this->timers_[iF] += dt;
+          if (this->timing_)
+            this->timing_->fill(this->timingStep_(iF, phase), toMS(dt), this->eventId_);
+          if (this->traceEvent_)
+            this->trace_->record(filler->getName(), phase == kFill ? "fill" : "setRefs", start, end,
+                                 this->eventId_.run, this->eventId_.lumi, this->eventId_.event);
+        }
       }
-    }
-    catch (std::exception& ex) {
-      std::cerr << "[PandaProducer:fill] " 
-        << "Error in " << filler->getName() << "::setRefs()" << std::endl;
-      throw;
-    }
+      catch (std::exception& ex) {
+        std::cerr << "[PandaProducer::analyze] "
+          << "Error in " << filler->getName() << "::" << stepName << std::endl;
+        throw;
+      }
+    });
+
+  if (scheduler_)
+    scheduler_->run(_step, task);
+  else {
+    for (unsigned iF(0); iF != fillers_.size(); ++iF)
+      task(iF);
   }
+}
 
-  outEvent_.fill(*eventTree_);
+void
+PandaProducer::resetArenas_()
+{
+  for (auto* filler : fillers_)
+    filler->getArena().reset();
 
-  lastAnalyze_ = SClock::now();
+  if (pfCandidateIndex_)
+    pfCandidateIndex_->reset();
+
+  if (genParticleIndex_)
+    genParticleIndex_->reset();
 }
 
 void
 PandaProducer::beginRun(edm::Run const& _run, edm::EventSetup const& _setup)
 {
+  // other trees of the output file are filled below
+  waitOutput_();
+
+  SClock::time_point start;
+  if (trace_)
+    start = SClock::now();
+
   outEvent_.run.init();
 
   outEvent_.run.runNumber = _run.run();
@@ -311,7 +638,7 @@ PandaProducer::beginRun(edm::Run const& _run, edm::EventSetup const& _setup)
   for (auto* filler : fillers_) {
     try {
       if (printLevel_ >= 2)
-        std::cout << "[PandaProducer::beginRun] " 
+        std::cout << "[PandaProducer::beginRun] "
           << "Calling " << filler->getName() << "->fillBeginRun()" << std::endl;
 
       filler->fillBeginRun(outEvent_.run, _run, _setup);
@@ -322,15 +649,24 @@ PandaProducer::beginRun(edm::Run const& _run, edm::EventSetup const& _setup)
       throw;
     }
   }
+
+  if (trace_)
+    trace_->record("beginRun", "transition", start, SClock::now(), _run.run());
 }
 
 void
 PandaProducer::endRun(edm::Run const& _run, edm::EventSetup const& _setup)
 {
+  waitOutput_();
+
+  SClock::time_point start;
+  if (trace_)
+    start = SClock::now();
+
   for (auto* filler : fillers_) {
     try {
-      if (printLevel_ >= 2) 
-        std::cout << "[PandaProducer::endRun] " 
+      if (printLevel_ >= 2)
+        std::cout << "[PandaProducer::endRun] "
           << "Calling " << filler->getName() << "->fillEndRun()" << std::endl;
 
       filler->fillEndRun(outEvent_.run, _run, _setup);
@@ -342,30 +678,94 @@ PandaProducer::endRun(edm::Run const& _run, edm::EventSetup const& _setup)
     }
   }
 
+  // Every stream sees every run transition; the runs tree of the first stream is used in the merged output
   outEvent_.run.fill(*runTree_);
+
+  if (trace_)
+    trace_->record("endRun", "transition", start, SClock::now(), _run.run());
 }
 
 void
 PandaProducer::beginLuminosityBlock(edm::LuminosityBlock const& _lumi, edm::EventSetup const& _setup)
 {
   nEventsInLumi_ = 0;
+
+  if (trace_) {
+    auto now(SClock::now());
+    trace_->record("beginLuminosityBlock", "transition", now, now, _lumi.run(), _lumi.luminosityBlock());
+  }
+}
+
+void
+PandaProducer::endLuminosityBlockSummary(edm::LuminosityBlock const& _lumi, edm::EventSetup const&, unsigned* _nEvents) const
+{
+  // called serially for each stream
+  *_nEvents += nEventsInLumi_;
+
+  if (trace_) {
+    auto now(SClock::now());
+    trace_->record("endLuminosityBlock", "transition", now, now, _lumi.run(), _lumi.luminosityBlock());
+  }
+}
+
+/*static*/
+std::shared_ptr<unsigned>
+PandaProducer::globalBeginLuminosityBlockSummary(edm::LuminosityBlock const& _lumi, edm::EventSetup const&, LuminosityBlockContext const* _context)
+{
+  auto& global(*_context->global());
+  if (global.trace) {
+    auto now(SClock::now());
+    global.trace->record("globalBeginLuminosityBlock", "transition", now, now, _lumi.run(), _lumi.luminosityBlock());
+  }
+
+  return std::make_shared<unsigned>(0);
 }
 
+/*static*/
 void
-PandaProducer::endLuminosityBlock(edm::LuminosityBlock const& _lumi, edm::EventSetup const& _setup)
+PandaProducer::globalEndLuminosityBlockSummary(edm::LuminosityBlock const& _lumi, edm::EventSetup const&, LuminosityBlockContext const* _context, unsigned* _nEvents)
 {
-  outEvent_.runNumber = _lumi.id().run();
-  outEvent_.lumiNumber = _lumi.id().luminosityBlock();
-  lumiSummaryTree_->Fill();
+  auto& global(*_context->global());
+
+  if (global.trace) {
+    auto now(SClock::now());
+    global.trace->record("globalEndLuminosityBlock", "transition", now, now, _lumi.run(), _lumi.luminosityBlock());
+  }
+
+  std::lock_guard<std::mutex> lock(global.mutex);
+  global.lumiSummaries.push_back({_lumi.id().run(), _lumi.id().luminosityBlock(), *_nEvents});
 }
 
-void 
-PandaProducer::beginJob()
+void
+PandaProducer::beginStream(edm::StreamID _streamId)
 {
-  outputFile_ = TFile::Open(outputName_.c_str(), "recreate");
+  auto& global(*globalCache());
+
+  TString streamOutputName(global.outputName);
+  if (streamOutputName.EndsWith(".root"))
+    streamOutputName.Remove(streamOutputName.Length() - 5);
+  streamOutputName += TString::Format("_stream%u.root", _streamId.value());
+  outputName_ = streamOutputName.Data();
+
+  {
+    std::lock_guard<std::mutex> lock(global.mutex);
+    global.streamOutputs.emplace(_streamId.value(), outputName_);
+  }
+
+  if (global.trace)
+    trace_.reset(new TraceRecorder(_streamId.value() + 1));
+
+  if (global.compressionSettings >= 0)
+    outputFile_ = TFile::Open(outputName_.c_str(), "recreate", "", global.compressionSettings);
+  else
+    outputFile_ = TFile::Open(outputName_.c_str(), "recreate");
+  if (!outputFile_ || outputFile_->IsZombie())
+    throw cms::Exception("PandaProducer") << "Cannot open output file " << outputName_;
+
+  TDirectory::TContext context(outputFile_);
+
   eventTree_ = new TTree("events", "");
   runTree_ = new TTree("runs", "");
-  lumiSummaryTree_ = new TTree("lumiSummary", "");
 
   panda::utils::BranchList eventBranches = {"runNumber", "lumiNumber", "eventNumber", "isData"};
   panda::utils::BranchList runBranches = {"runNumber"};
@@ -375,9 +775,7 @@ PandaProducer::beginJob()
   outEvent_.book(*eventTree_, eventBranches);
   outEvent_.run.book(*runTree_, runBranches);
 
-  lumiSummaryTree_->Branch("runNumber", &outEvent_.runNumber, "runNumber/i");
-  lumiSummaryTree_->Branch("lumiNumber", &outEvent_.lumiNumber, "lumiNumber/i");
-  lumiSummaryTree_->Branch("nEvents", &nEventsInLumi_, "nEventsInLumi_/i");
+  configureEventTree_();
 
   for (auto* filler : fillers_)
     filler->addOutput(*outputFile_);
@@ -394,31 +792,154 @@ PandaProducer::beginJob()
   eventCounter_->SetDirectory(outputFile_);
   eventCounter_->GetXaxis()->SetBinLabel(1, "all");
   eventCounter_->GetXaxis()->SetBinLabel(2, "selected");
+
+  if (asyncOutput_)
+    writer_.reset(new AsyncTreeWriter);
 }
 
-void 
-PandaProducer::endJob()
+void
+PandaProducer::endStream()
 {
+  if (writer_) {
+    writer_->wait();
+    writer_.reset();
+  }
+
   // writes out all outputs that are still hanging in the directory
   outputFile_->cd();
   outputFile_->Write();
   delete outputFile_;
+  outputFile_ = 0;
 
   if (printLevel_ >= 1) {
+    auto& global(*globalCache());
+
+    std::lock_guard<std::mutex> lock(global.mutex);
+
+    if (global.timers.empty()) {
+      for (auto* filler : fillers_)
+        global.timerNames.push_back(filler->getName());
+      global.timerNames.push_back("Other CMSSW");
+      global.timers.assign(timers_.size(), SClock::duration::zero());
+      global.scratchAllocations.assign(fillers_.size(), 0);
+      global.scratchBlockAllocations.assign(fillers_.size(), 0);
+    }
+
+    for (unsigned iT(0); iT != timers_.size(); ++iT)
+      global.timers[iT] += timers_[iT];
+
+    for (unsigned iF(0); iF != fillers_.size(); ++iF) {
+      auto& arena(fillers_[iF]->getArena());
+      global.scratchAllocations[iF] += arena.nAllocations();
+      global.scratchBlockAllocations[iF] += arena.nBlockAllocations();
+    }
+
+    global.nEvents += nEvents_;
+    if (nEvents_ > 1)
+      global.nOtherSteps += nEvents_ - 1;
+  }
+
+  if (timing_) {
+    auto& global(*globalCache());
+
+    std::lock_guard<std::mutex> lock(global.mutex);
+
+    if (global.timing)
+      global.timing->merge(*timing_);
+    else
+      global.timing.reset(new TimingReport(*timing_));
+  }
+
+  if (trace_)
+    globalCache()->trace->absorb(*trace_);
+}
+
+/*static*/
+void
+PandaProducer::globalEndJob(PandaProducerGlobal* _global)
+{
+  auto& global(*_global);
+
+  // std::map -> stream outputs are ordered by the stream index (the events are sorted in the merge anyway)
+  std::vector<std::string> inputs;
+  for (auto& so : global.streamOutputs)
+    inputs.push_back(so.second);
+
+  if (inputs.size() == 1) {
+    // a single stream sees the events in the input order
+    if (std::rename(inputs[0].c_str(), global.outputName.c_str()) != 0)
+      throw cms::Exception("PandaProducer") << "Failed to rename " << inputs[0] << " to " << global.outputName;
+  }
+  else if (inputs.size() > 1) {
+    mergeStreamOutputs_(inputs, global.outputName, global.compressionSettings);
+
+    for (auto& input : inputs)
+      std::remove(input.c_str());
+  }
+  else
+    return;
+
+  // Luminosity block summary is accumulated over streams and written to the final output directly
+  std::unique_ptr<TFile> outputFile(TFile::Open(global.outputName.c_str(), "update"));
+  if (!outputFile || outputFile->IsZombie())
+    throw cms::Exception("PandaProducer") << "Cannot open output file " << global.outputName;
+
+  outputFile->cd();
+
+  PandaProducerGlobal::LumiSummary summary;
+  auto* lumiSummaryTree(new TTree("lumiSummary", ""));
+  lumiSummaryTree->Branch("runNumber", &summary.runNumber, "runNumber/i");
+  lumiSummaryTree->Branch("lumiNumber", &summary.lumiNumber, "lumiNumber/i");
+  lumiSummaryTree->Branch("nEvents", &summary.nEvents, "nEventsInLumi_/i");
+
+  for (auto& s : global.lumiSummaries) {
+    summary = s;
+    lumiSummaryTree->Fill();
+  }
+
+  lumiSummaryTree->Write();
+
+  if (global.branchSizeReport) {
+    auto* eventTree(static_cast<TTree*>(outputFile->Get("events")));
+    if (eventTree)
+      printBranchSizes_(*eventTree);
+  }
+
+  if (global.timing) {
+    global.timing->write(*outputFile);
+
+    if (!global.timingJSON.empty()) {
+      std::ofstream json(global.timingJSON);
+      if (!json)
+        throw cms::Exception("PandaProducer") << "Cannot open timing report file " << global.timingJSON;
+      global.timing->writeJSON(json);
+    }
+  }
+
+  outputFile->Close();
+
+  if (global.trace) {
+    std::ofstream json(global.traceFile);
+    if (!json)
+      throw cms::Exception("PandaProducer") << "Cannot open trace file " << global.traceFile;
+    global.trace->writeJSON(json);
+  }
+
+  if (global.printLevel >= 1 && global.nEvents != 0) {
     double total(0.);
 
     std::cout << "[PandaProducer::endJob] Timer summary" << std::endl;
-    for (unsigned iF(0); iF != fillers_.size(); ++iF) {
-      double msPerEvt(toMS(timers_[iF]) / nEvents_);
-      std::cout << " " << fillers_[iF]->getName() << "  "
+    for (unsigned iT(0); iT != global.timers.size() - 1; ++iT) {
+      double msPerEvt(toMS(global.timers[iT]) / global.nEvents);
+      std::cout << " " << global.timerNames[iT] << "  "
                 << std::fixed << std::setprecision(3) << msPerEvt << " ms/evt"
                 << std::endl;
 
       total += msPerEvt;
     }
-    if (nEvents_ > 1) {
-      double msPerEvt(toMS(timers_.back()) / (nEvents_ - 1));
-      std::cout << " Other CMSSW  "
+    if (global.nOtherSteps != 0) {
+      double msPerEvt(toMS(global.timers.back()) / global.nOtherSteps);
+      std::cout << " " << global.timerNames.back() << "  "
                 << std::fixed << std::setprecision(3) << msPerEvt << " ms/evt"
                 << std::endl;
 
@@ -427,6 +948,286 @@ PandaProducer::endJob()
     std::cout << std::endl << " Total  "
               << std::fixed << std::setprecision(3) << total << " ms/evt"
               << std::endl;
+
+    // Scratch allocations served by the filler arenas (would each be a malloc with std containers)
+    // vs. blocks actually requested from the system
+    std::cout << std::endl << "[PandaProducer::endJob] Scratch allocations per event (arena -> system)" << std::endl;
+    for (unsigned iF(0); iF != global.scratchAllocations.size(); ++iF) {
+      if (global.scratchAllocations[iF] == 0)
+        continue;
+
+      std::cout << " " << global.timerNames[iF] << "  "
+                << std::fixed << std::setprecision(1) << double(global.scratchAllocations[iF]) / global.nEvents << " -> "
+                << std::setprecision(3) << double(global.scratchBlockAllocations[iF]) / global.nEvents
+                << std::endl;
+    }
+  }
+}
+
+void
+PandaProducer::configureEventTree_()
+{
+  if (basketSize_ > 0)
+    eventTree_->SetBasketSize("*", basketSize_);
+
+  for (auto& spec : branchBasketSizes_) {
+    size_t colon(spec.rfind(':'));
+    int size(0);
+    if (colon != std::string::npos) {
+      try {
+        size = std::stoi(spec.substr(colon + 1));
+      }
+      catch (std::exception&) {
+      }
+    }
+    if (size <= 0)
+      throw edm::Exception(edm::errors::Configuration, "PandaProducer")
+        << "Invalid branchBasketSizes entry " << spec << " (expected branch:size)";
+
+    eventTree_->SetBasketSize(spec.substr(0, colon).c_str(), size);
+  }
+
+  // positive = number of entries, negative = bytes per cluster
+  if (autoFlush_ != 0)
+    eventTree_->SetAutoFlush(autoFlush_);
+}
+
+/*static*/
+void
+PandaProducer::printBranchSizes_(TTree& _tree)
+{
+  struct BranchSize {
+    std::string name;
+    double totBytes;
+    double zipBytes;
+  };
+
+  std::vector<BranchSize> sizes;
+  double totTotal(0.);
+  double zipTotal(0.);
+  for (auto* obj : *_tree.GetListOfBranches()) {
+    auto* branch(static_cast<TBranch*>(obj));
+    // "*": include sub-branches
+    sizes.push_back({branch->GetName(), double(branch->GetTotBytes("*")), double(branch->GetZipBytes("*"))});
+    totTotal += sizes.back().totBytes;
+    zipTotal += sizes.back().zipBytes;
+  }
+
+  std::sort(sizes.begin(), sizes.end(), [](BranchSize const& b1, BranchSize const& b2) { return b1.zipBytes > b2.zipBytes; });
+
+  double const kB(1024.);
+  double nEntries(std::max(1LL, _tree.GetEntries()));
+
+  std::cout << "[PandaProducer::endJob] Branch sizes (" << _tree.GetEntries() << " entries)" << std::endl;
+  std::cout << " " << std::left << std::setw(40) << "branch" << std::right
+            << std::setw(14) << "kB (disk)" << std::setw(14) << "kB (memory)" << std::setw(8) << "ratio"
+            << std::setw(10) << "B/evt" << std::setw(8) << "%disk" << std::endl;
+  for (auto& size : sizes) {
+    std::cout << " " << std::left << std::setw(40) << size.name << std::right << std::fixed
+              << std::setprecision(1) << std::setw(14) << size.zipBytes / kB << std::setw(14) << size.totBytes / kB
+              << std::setprecision(2) << std::setw(8) << (size.zipBytes > 0. ? size.totBytes / size.zipBytes : 0.)
+              << std::setprecision(1) << std::setw(10) << size.zipBytes / nEntries
+              << std::setw(8) << (zipTotal > 0. ? size.zipBytes / zipTotal * 100. : 0.)
+              << std::endl;
+  }
+  std::cout << " " << std::left << std::setw(40) << "Total" << std::right << std::fixed
+            << std::setprecision(1) << std::setw(14) << zipTotal / kB << std::setw(14) << totTotal / kB
+            << std::setprecision(2) << std::setw(8) << (zipTotal > 0. ? totTotal / zipTotal : 0.)
+            << std::setprecision(1) << std::setw(10) << zipTotal / nEntries << std::endl;
+}
+
+/*static*/
+void
+PandaProducer::mergeStreamOutputs_(std::vector<std::string> const& _inputs, std::string const& _output, int _compressionSettings)
+{
+  // The events tree and the histograms (event counters, sums of weights etc.) are summed over the streams.
+  // Everything else (runs, hlt menus, documentation trees) is written identically by all streams and is
+  // copied from the first stream file.
+  // Which events a stream sees depends on the scheduling, so the stream files are first concatenated into
+  // a temporary file, and the events tree is then copied into the output in (run, lumi, event) order. The
+  // merged output therefore does not depend on the scheduling. The baskets of the events tree are
+  // decompressed and recompressed in this copy.
+  checkStreamOutputs_(_inputs);
+
+  std::unique_ptr<TFile> firstInput(TFile::Open(_inputs[0].c_str()));
+  if (!firstInput || firstInput->IsZombie())
+    throw cms::Exception("PandaProducer") << "Cannot open stream output " << _inputs[0];
+
+  TString mergedNames;
+  std::vector<std::string> summedNames;
+  std::set<std::string> copiedNames;
+  std::set<std::string> seen;
+  for (auto* obj : *firstInput->GetListOfKeys()) {
+    auto* key(static_cast<TKey*>(obj));
+    if (!seen.insert(key->GetName()).second) // older cycle
+      continue;
+
+    TClass* cls(TClass::GetClass(key->GetClassName()));
+    if (std::strcmp(key->GetName(), "events") == 0 || (cls && cls->InheritsFrom(TH1::Class()))) {
+      mergedNames += TString(key->GetName()) + " ";
+      if (std::strcmp(key->GetName(), "events") != 0)
+        summedNames.push_back(key->GetName());
+    }
+    else
+      copiedNames.insert(key->GetName());
+  }
+
+  int compressionSettings(_compressionSettings >= 0 ? _compressionSettings : firstInput->GetCompressionSettings());
+
+  // entry offset of each stream in the concatenated events tree
+  std::vector<Long64_t> streamOffsets;
+  Long64_t nEntries(0);
+  for (auto& input : _inputs) {
+    std::unique_ptr<TFile> file(TFile::Open(input.c_str()));
+    if (!file || file->IsZombie())
+      throw cms::Exception("PandaProducer") << "Cannot open stream output " << input;
+    auto* eventTree(static_cast<TTree*>(file->Get("events")));
+    streamOffsets.push_back(nEntries);
+    nEntries += eventTree ? eventTree->GetEntries() : 0;
+  }
+
+  std::string concatName(_output + ".unsorted.root");
+
+  {
+    TFileMerger merger(false, false);
+    merger.SetPrintLevel(0);
+    // keep the compression of the stream files so that the baskets can be copied without recompression
+    if (!merger.OutputFile(concatName.c_str(), "recreate", compressionSettings))
+      throw cms::Exception("PandaProducer") << "Cannot open output file " << concatName;
+
+    for (auto& input : _inputs)
+      merger.AddFile(input.c_str(), false);
+
+    merger.AddObjectNames(mergedNames);
+
+    if (!merger.PartialMerge(TFileMerger::kAll | TFileMerger::kRegular | TFileMerger::kOnlyListed))
+      throw cms::Exception("PandaProducer") << "Failed to merge stream outputs into " << concatName;
+  }
+
+  std::unique_ptr<TFile> concatFile(TFile::Open(concatName.c_str()));
+  if (!concatFile || concatFile->IsZombie())
+    throw cms::Exception("PandaProducer") << "Cannot open merged stream outputs " << concatName;
+
+  std::unique_ptr<TFile> outputFile(TFile::Open(_output.c_str(), "recreate", "", compressionSettings));
+  if (!outputFile || outputFile->IsZombie())
+    throw cms::Exception("PandaProducer") << "Cannot open output file " << _output;
+
+  if (auto* eventsKey = concatFile->GetKey("events")) {
+    auto* concatTree(static_cast<TTree*>(concatFile->Get("events")));
+
+    TTreeIndex index(concatTree, "runNumber", "lumiNumber * 4294967296. + eventNumber");
+    if (index.IsZombie() || index.GetN() != nEntries)
+      throw cms::Exception("PandaProducer") << "Failed to sort the events of " << concatName;
+
+    // One reader per stream: the entries of a stream are contiguous in the concatenated tree and are mostly
+    // requested in increasing order, so each reader keeps decompressing consecutive baskets instead of
+    // jumping between the stream blocks. All readers are instances of the same tree (same array maxima)
+    // and read into the buffers of the sorted tree.
+    std::vector<TTree*> readers{concatTree};
+    for (unsigned iS(1); iS < _inputs.size(); ++iS)
+      readers.push_back(static_cast<TTree*>(eventsKey->ReadObj()));
+
+    auto* sortedTree(concatTree->CloneTree(0));
+    sortedTree->SetDirectory(outputFile.get());
+    for (unsigned iS(1); iS < readers.size(); ++iS)
+      sortedTree->CopyAddresses(readers[iS]);
+
+    Long64_t const* order(index.GetIndex());
+    for (Long64_t iE(0); iE != nEntries; ++iE) {
+      Long64_t entry(order[iE]);
+      unsigned iS(std::upper_bound(streamOffsets.begin(), streamOffsets.end(), entry) - streamOffsets.begin() - 1);
+      readers[iS]->GetEntry(entry);
+      sortedTree->Fill();
+    }
+
+    outputFile->cd();
+    sortedTree->Write();
+  }
+
+  for (auto& name : summedNames) {
+    auto* obj(concatFile->Get(name.c_str()));
+    if (!obj)
+      continue;
+
+    outputFile->cd();
+    obj->Write(name.c_str());
+  }
+
+  for (auto& name : copiedNames) {
+    auto* obj(firstInput->Get(name.c_str()));
+    if (!obj)
+      continue;
+
+    outputFile->cd();
+    if (obj->InheritsFrom(TTree::Class()))
+      static_cast<TTree*>(obj)->CloneTree(-1, "fast")->Write();
+    else
+      obj->Write(name.c_str());
+  }
+  outputFile->Close();
+
+  concatFile->Close();
+  std::remove(concatName.c_str());
+}
+
+/*static*/
+void
+PandaProducer::checkStreamOutputs_(std::vector<std::string> const& _inputs)
+{
+  // One line per top-level object, per events leaf and per histogram axis
+  auto describe([](TFile& _file)->std::vector<std::string> {
+    std::vector<std::string> lines;
+    std::set<std::string> seen;
+    for (auto* obj : *_file.GetListOfKeys()) {
+      auto* key(static_cast<TKey*>(obj));
+      if (!seen.insert(key->GetName()).second) // older cycle
+        continue;
+
+      lines.push_back(TString::Format("%s (%s)", key->GetName(), key->GetClassName()).Data());
+
+      TClass* cls(TClass::GetClass(key->GetClassName()));
+      if (std::strcmp(key->GetName(), "events") == 0) {
+        auto* eventTree(static_cast<TTree*>(_file.Get("events")));
+        for (auto* lobj : *eventTree->GetListOfLeaves()) {
+          auto* leaf(static_cast<TLeaf*>(lobj));
+          lines.push_back(TString::Format("events branch %s: %s/%s", leaf->GetBranch()->GetName(), leaf->GetTitle(), leaf->GetTypeName()).Data());
+        }
+      }
+      else if (cls && cls->InheritsFrom(TH1::Class())) {
+        auto* hist(static_cast<TH1*>(_file.Get(key->GetName())));
+        auto* axis(hist->GetXaxis());
+        TString line(TString::Format("%s binning: %d bins in [%g, %g]", key->GetName(), axis->GetNbins(), axis->GetXmin(), axis->GetXmax()));
+        if (axis->GetLabels()) {
+          for (int iB(1); iB <= axis->GetNbins(); ++iB)
+            line += TString(" ") + axis->GetBinLabel(iB);
+        }
+        lines.push_back(line.Data());
+      }
+    }
+    return lines;
+  });
+
+  std::vector<std::string> reference;
+
+  for (auto& input : _inputs) {
+    std::unique_ptr<TFile> file(TFile::Open(input.c_str()));
+    if (!file || file->IsZombie())
+      throw cms::Exception("PandaProducer") << "Cannot open stream output " << input;
+
+    auto&& lines(describe(*file));
+
+    if (&input == &_inputs[0]) {
+      reference = std::move(lines);
+      continue;
+    }
+
+    if (lines == reference)
+      continue;
+
+    auto mismatch(std::mismatch(reference.begin(), reference.end(), lines.begin(), lines.end()));
+    throw cms::Exception("PandaProducer") << "Stream outputs " << _inputs[0] << " and " << input << " cannot be merged: "
+                                          << (mismatch.first == reference.end() ? std::string("(none)") : *mismatch.first) << " vs "
+                                          << (mismatch.second == lines.end() ? std::string("(none)") : *mismatch.second);
   }
 }
 
@@ -10,6 +10,8 @@ options.register('lumilist', default = '', mult = VarParsing.multiplicity.single
 options.register('isData', default = False, mult = VarParsing.multiplicity.singleton, mytype = VarParsing.varType.bool, info = 'True if running on Data, False if running on MC')
 options.register('useTrigger', default = True, mult = VarParsing.multiplicity.singleton, mytype = VarParsing.varType.bool, info = 'Fill trigger information')
 options.register('printLevel', default = 0, mult = VarParsing.multiplicity.singleton, mytype = VarParsing.varType.int, info = 'Debug level of the ntuplizer')
+options.register('nThreads', default = 1, mult = VarParsing.multiplicity.singleton, mytype = VarParsing.varType.int, info = 'Number of threads (= number of streams). PandaProducer writes one file per stream and merges them at the end of the job. With nThreads > 1 the merged events tree is sorted by (runNumber, lumiNumber, eventNumber)')
+options.register('parallelFillers', default = False, mult = VarParsing.multiplicity.singleton, mytype = VarParsing.varType.bool, info = 'Run independent fillers of one event concurrently. Useful when nThreads exceeds the number of concurrent events')
 options.register('skipEvents', default = 0, mult = VarParsing.multiplicity.singleton, mytype = VarParsing.varType.int, info = 'Skip first events')
 options.register('dumpPython', default = False, mult = VarParsing.multiplicity.singleton, mytype = VarParsing.varType.bool, info = 'Dumps configuration as single python file to stdout')
 options._tags.pop('numEvent%d')
@@ -2,10 +2,23 @@ import FWCore.ParameterSet.Config as cms
 
 panda = cms.EDAnalyzer('PandaProducer',
     isRealData = cms.untracked.bool(False),
-    outputFile = cms.untracked.string('panda.root'),
+    outputFile = cms.untracked.string('panda.root'), # with multiple streams, one file per stream merged at the end of the job; the merged events are sorted by (run, lumi, event)
     useTrigger = cms.untracked.bool(True),
     SelectEvents = cms.untracked.vstring(),
     printLevel = cms.untracked.uint32(0),
+    parallelFillers = cms.untracked.bool(False),
+    timingReport = cms.untracked.bool(False), # latency histograms and percentiles per filler and step
+    timingJSON = cms.untracked.string(''), # if timingReport, also write the percentiles to this JSON file
+    traceFile = cms.untracked.string(''), # write a Chrome trace (chrome://tracing, ui.perfetto.dev) of the filler calls to this file
+    traceMaxEvents = cms.untracked.uint32(1000), # per stream; 0 = all events
+    compressionAlgorithm = cms.untracked.string(''), # ZLIB, LZMA, LZ4, ZSTD (ROOT >= 6.20); empty = ROOT default
+    compressionLevel = cms.untracked.int32(-1), # 0-9; -1 = ROOT default for the algorithm (ZLIB 1, LZMA 7, LZ4 4, ZSTD 5)
+    basketSize = cms.untracked.int32(0), # initial basket size of all event branches (bytes); 0 = ROOT default
+    branchBasketSizes = cms.untracked.vstring(), # 'branch:size' overrides; wildcards allowed, e.g. 'pfCandidates*:256000'
+    autoFlush = cms.untracked.int64(0), # TTree::SetAutoFlush; >0 entries, <0 bytes per cluster, 0 = ROOT default
+    optimizeBasketsAfter = cms.untracked.uint32(0), # call TTree::OptimizeBaskets after this number of events; 0 = never
+    branchSizeReport = cms.untracked.bool(False), # print compressed/uncompressed bytes per branch at the end of the job
+    asyncOutput = cms.untracked.bool(False), # fill the events tree on a dedicated thread, overlapping with the next event
     fillers = cms.untracked.PSet(
         common = cms.untracked.PSet(
             genEventInfo = cms.untracked.string('generator'),
@@ -106,6 +119,15 @@ panda = cms.EDAnalyzer('PandaProducer',
             subjetDeepCSV = cms.untracked.string('pfDeepCSVJetTags'),
             subjetDeepCMVA = cms.untracked.string('pfDeepCMVAJetTags'),
             computeSubstructure = cms.untracked.string('always'),
+            substructure = cms.untracked.vstring('ecfs', 'tauSD', 'htt'), # quantities to compute
+            substructureMaxJets = cms.untracked.uint32(2), # compute for the leading N jets passing the preselection
+            substructureMinPt = cms.untracked.double(0.),
+            substructureMinMass = cms.untracked.double(0.),
+            substructureMaxEta = cms.untracked.double(-1.), # negative = no cut
+            ecfMaxConstituents = cms.untracked.uint32(100),
+            ecfTolerance = cms.untracked.double(0.), # nonzero = truncate the N=4 ECF sum at this relative pT-product tolerance
+            httReuseSubjets = cms.untracked.bool(True), # False = rerun HTT on every subjet at every R (reference)
+            substructureArea = cms.untracked.bool(False), # True = recluster with explicit ghosts (reference)
             recoil = cms.untracked.string('MonoXFilter:categories'),
             fillConstituents = cms.untracked.bool(True),
             minPt = cms.untracked.double(180.),
@@ -134,6 +156,15 @@ panda = cms.EDAnalyzer('PandaProducer',
             subjetDeepCSV = cms.untracked.string('pfDeepCSVJetTags'),
             subjetDeepCMVA = cms.untracked.string('pfDeepCMVAJetTags'),
             computeSubstructure = cms.untracked.string('recoil'),
+            substructure = cms.untracked.vstring('ecfs', 'tauSD', 'htt'), # quantities to compute
+            substructureMaxJets = cms.untracked.uint32(2), # compute for the leading N jets passing the preselection
+            substructureMinPt = cms.untracked.double(0.),
+            substructureMinMass = cms.untracked.double(0.),
+            substructureMaxEta = cms.untracked.double(-1.), # negative = no cut
+            ecfMaxConstituents = cms.untracked.uint32(100),
+            ecfTolerance = cms.untracked.double(0.), # nonzero = truncate the N=4 ECF sum at this relative pT-product tolerance
+            httReuseSubjets = cms.untracked.bool(True), # False = rerun HTT on every subjet at every R (reference)
+            substructureArea = cms.untracked.bool(False), # True = recluster with explicit ghosts (reference)
             recoil = cms.untracked.string('MonoXFilter:categories'),
             fillConstituents = cms.untracked.bool(True),
             minPt = cms.untracked.double(180.),
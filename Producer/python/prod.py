@@ -31,7 +31,7 @@ import FWCore.ParameterSet.Config as cms
 process = cms.Process('NTUPLES')
 
 process.options = cms.untracked.PSet(
-    numberOfThreads = cms.untracked.uint32(1),
+    numberOfThreads = cms.untracked.uint32(options.nThreads),
     numberOfStreams = cms.untracked.uint32(0)
 )
 
@@ -457,6 +457,7 @@ process.panda.fillers.muons.rochesterCorrectionSource = 'PandaProd/Utilities/dat
 
 process.panda.outputFile = options.outputFile
 process.panda.printLevel = options.printLevel
+process.panda.parallelFillers = options.parallelFillers
 
 process.ntuples = cms.EndPath(process.panda)
 
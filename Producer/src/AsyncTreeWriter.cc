@@ -0,0 +1,78 @@
+#include "../interface/AsyncTreeWriter.h"
+
+AsyncTreeWriter::AsyncTreeWriter() :
+  thread_([this]() { this->run_(); })
+{
+}
+
+AsyncTreeWriter::~AsyncTreeWriter()
+{
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    cv_.wait(lock, [this]() { return !this->busy_; });
+    stop_ = true;
+  }
+  cv_.notify_all();
+  thread_.join();
+}
+
+void
+AsyncTreeWriter::submit(std::function<void()> const& _job)
+{
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    cv_.wait(lock, [this]() { return !this->busy_; });
+    rethrow_();
+
+    job_ = _job;
+    busy_ = true;
+  }
+  cv_.notify_all();
+}
+
+void
+AsyncTreeWriter::wait()
+{
+  std::unique_lock<std::mutex> lock(mutex_);
+  cv_.wait(lock, [this]() { return !this->busy_; });
+  rethrow_();
+}
+
+void
+AsyncTreeWriter::run_()
+{
+  std::unique_lock<std::mutex> lock(mutex_);
+
+  while (true) {
+    cv_.wait(lock, [this]() { return this->busy_ || this->stop_; });
+    if (stop_)
+      break;
+
+    auto job(std::move(job_));
+    lock.unlock();
+
+    try {
+      job();
+    }
+    catch (...) {
+      lock.lock();
+      exception_ = std::current_exception();
+      lock.unlock();
+    }
+
+    lock.lock();
+    busy_ = false;
+    cv_.notify_all();
+  }
+}
+
+void
+AsyncTreeWriter::rethrow_()
+{
+  // called with the mutex held
+  if (exception_) {
+    auto ex(exception_);
+    exception_ = nullptr;
+    std::rethrow_exception(ex);
+  }
+}
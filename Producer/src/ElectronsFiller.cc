@@ -9,7 +9,6 @@
 #include "DataFormats/EgammaCandidates/interface/Conversion.h"
 #include "DataFormats/PatCandidates/interface/Electron.h"
 #include "DataFormats/HepMCCandidate/interface/GenStatusFlags.h"
-#include "DataFormats/Math/interface/deltaR.h"
 
 #include <cmath>
 
@@ -27,7 +26,6 @@ ElectronsFiller::ElectronsFiller(std::string const& _name, edm::ParameterSet con
   getToken_(regressionElectronsToken_, _cfg, _coll, "regressionElectrons", false);
   getToken_(photonsToken_, _cfg, _coll, "photons", "photons");
   getToken_(conversionsToken_, _cfg, _coll, "common", "conversions");
-  getToken_(pfCandidatesToken_, _cfg, _coll, "common", "pfCandidates");
   getToken_(ebHitsToken_, _cfg, _coll, "common", "ebHits");
   getToken_(eeHitsToken_, _cfg, _coll, "common", "eeHits");
   getToken_(beamSpotToken_, _cfg, _coll, "common", "beamSpot");
@@ -63,6 +61,15 @@ ElectronsFiller::branchNames(panda::utils::BranchList& _eventBranches, panda::ut
     _eventBranches.emplace_back("!electrons.matchedGen_");
 }
 
+void
+ElectronsFiller::declareAccess(FillerAccess&, FillerAccess& _setRefsAccess) const
+{
+  _setRefsAccess.reads.emplace_back("superClusters");
+  _setRefsAccess.reads.emplace_back("pfCandidates");
+  _setRefsAccess.reads.emplace_back("vertices");
+  _setRefsAccess.reads.emplace_back("genParticles");
+}
+
 void
 ElectronsFiller::fill(panda::Event& _outEvent, edm::Event const& _inEvent, edm::EventSetup const& _setup)
 {
@@ -70,7 +77,7 @@ ElectronsFiller::fill(panda::Event& _outEvent, edm::Event const& _inEvent, edm::
   auto* inSmearedElectrons(getProductSafe_(_inEvent, smearedElectronsToken_));
   auto* inRegressionElectrons(getProductSafe_(_inEvent, regressionElectronsToken_));
   auto& photons(getProduct_(_inEvent, photonsToken_));
-  auto& pfCandidates(getProduct_(_inEvent, pfCandidatesToken_));
+  auto& pfIndex(getPFCandidateIndex_(_inEvent));
   auto& ebHits(getProduct_(_inEvent, ebHitsToken_));
   auto& eeHits(getProduct_(_inEvent, eeHitsToken_));
   auto& beamSpot(getProduct_(_inEvent, beamSpotToken_));
@@ -113,24 +120,13 @@ ElectronsFiller::fill(panda::Event& _outEvent, edm::Event const& _inEvent, edm::
       return &*hitItr;
     });
 
-  auto findPF([&pfCandidates](reco::GsfElectron const& inElectron)->reco::CandidatePtr {
-      int iMatch(-1);
-
-      double minDR(0.1);
-      for (unsigned iPF(0); iPF != pfCandidates.size(); ++iPF) {
-        auto& pf(pfCandidates.at(iPF));
-        if (std::abs(pf.pdgId()) != 11 || pf.pdgId() == 22)
-          continue;
-
-        double dR(reco::deltaR(pf, inElectron));
-        if (dR < minDR) {
-          minDR = dR;
-          iMatch = iPF;
-        }
-      }
+  auto findPF([&pfIndex](reco::GsfElectron const& inElectron)->reco::CandidatePtr {
+      int iMatch(pfIndex.grid().findClosest(inElectron.eta(), inElectron.phi(), 0.1, [&pfIndex](unsigned iPF) {
+            return std::abs(pfIndex.pdgId(iPF)) == 11;
+          }));
 
       if (iMatch >= 0)
-        return pfCandidates.ptrAt(iMatch);
+        return pfIndex.ptrAt(iMatch);
       else
         return reco::CandidatePtr();
     });
@@ -0,0 +1,101 @@
+#include "../interface/EtaPhiGrid.h"
+
+#include <cmath>
+
+EtaPhiGrid::EtaPhiGrid(double _cellSize/* = 0.4*/, double _maxEta/* = 5.*/) :
+  cellSize_(_cellSize),
+  maxEta_(_maxEta),
+  nEta_(std::max(1, int(std::ceil(2. * _maxEta / _cellSize)))),
+  nPhi_(std::max(1, int(2. * M_PI / _cellSize)))
+{
+}
+
+void
+EtaPhiGrid::clear()
+{
+  eta_.clear();
+  phi_.clear();
+  cells_.clear();
+  indices_.clear();
+  offsets_.assign(nEta_ * nPhi_ + 1, 0);
+}
+
+void
+EtaPhiGrid::add(double _eta, double _phi)
+{
+  eta_.push_back(_eta);
+  phi_.push_back(_phi);
+}
+
+void
+EtaPhiGrid::build()
+{
+  unsigned nCells(nEta_ * nPhi_);
+
+  // counting sort of the points by cell
+  offsets_.assign(nCells + 1, 0);
+  cells_.resize(eta_.size());
+  for (unsigned iP(0); iP != eta_.size(); ++iP) {
+    unsigned cell(etaBin_(eta_[iP]) * nPhi_ + phiBin_(phi_[iP]));
+    cells_[iP] = cell;
+    ++offsets_[cell + 1];
+  }
+  for (unsigned iC(0); iC != nCells; ++iC)
+    offsets_[iC + 1] += offsets_[iC];
+
+  indices_.resize(eta_.size());
+  std::vector<unsigned>& fill(candidates_);
+  fill.assign(offsets_.begin(), offsets_.end() - 1);
+  for (unsigned iP(0); iP != eta_.size(); ++iP)
+    indices_[fill[cells_[iP]]++] = iP;
+}
+
+void
+EtaPhiGrid::findNear(double _eta, double _phi, double _dR, std::vector<unsigned>& _result) const
+{
+  _result.clear();
+  forEachNear(_eta, _phi, _dR, [&_result](unsigned idx, double) { _result.push_back(idx); });
+}
+
+int
+EtaPhiGrid::findFirst(double _eta, double _phi, double _dR) const
+{
+  double dR2max(_dR * _dR);
+  int first(-1);
+  forEachNearUnordered(_eta, _phi, _dR, [dR2max, &first](unsigned idx, double dR2) {
+      if (dR2 < dR2max && (first < 0 || int(idx) < first))
+        first = idx;
+    });
+  return first;
+}
+
+unsigned
+EtaPhiGrid::etaBin_(double _eta) const
+{
+  if (_eta <= -maxEta_)
+    return 0;
+  if (_eta >= maxEta_)
+    return nEta_ - 1;
+  return std::min(nEta_ - 1, unsigned((_eta + maxEta_) / cellSize_));
+}
+
+unsigned
+EtaPhiGrid::phiBin_(double _phi) const
+{
+  double phi(std::fmod(_phi, 2. * M_PI));
+  if (phi < 0.)
+    phi += 2. * M_PI;
+  return std::min(nPhi_ - 1, unsigned(phi / (2. * M_PI) * nPhi_));
+}
+
+/*static*/
+double
+EtaPhiGrid::deltaPhi_(double _phi1, double _phi2)
+{
+  double dPhi(_phi1 - _phi2);
+  while (dPhi > M_PI)
+    dPhi -= 2. * M_PI;
+  while (dPhi <= -M_PI)
+    dPhi += 2. * M_PI;
+  return dPhi;
+}
@@ -0,0 +1,70 @@
+#include "../interface/EventArena.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstdint>
+
+EventArena::~EventArena()
+{
+  for (auto& block : blocks_)
+    std::free(block.data);
+}
+
+void*
+EventArena::allocate(size_t _bytes, size_t _alignment/* = alignof(std::max_align_t)*/)
+{
+  ++nAllocations_;
+
+  while (current_ < blocks_.size()) {
+    auto& block(blocks_[current_]);
+    uintptr_t address(reinterpret_cast<uintptr_t>(block.data) + offset_);
+    size_t padding((_alignment - address % _alignment) % _alignment);
+
+    if (offset_ + padding + _bytes <= block.size) {
+      offset_ += padding + _bytes;
+      return block.data + offset_ - _bytes;
+    }
+
+    used_ += offset_;
+    ++current_;
+    offset_ = 0;
+  }
+
+  addBlock_(std::max(blockSize_, _bytes + _alignment));
+
+  // recursion terminates: the new block can hold the request
+  --nAllocations_;
+  return allocate(_bytes, _alignment);
+}
+
+void
+EventArena::reset()
+{
+  if (current_ != 0 && blocks_.size() > 1) {
+    // replace the blocks with a single one large enough for this event
+    size_t total(used_ + offset_);
+    for (auto& block : blocks_)
+      total = std::max(total, block.size);
+
+    for (auto& block : blocks_)
+      std::free(block.data);
+    blocks_.clear();
+
+    addBlock_(total);
+  }
+
+  current_ = 0;
+  offset_ = 0;
+  used_ = 0;
+}
+
+void
+EventArena::addBlock_(size_t _size)
+{
+  char* data(static_cast<char*>(std::malloc(_size)));
+  if (!data)
+    throw std::bad_alloc();
+
+  blocks_.push_back({data, _size});
+  ++nBlockAllocations_;
+}
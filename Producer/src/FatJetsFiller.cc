@@ -2,9 +2,11 @@
 
 #include "DataFormats/PatCandidates/interface/Jet.h"
 #include "DataFormats/JetReco/interface/GenJet.h"
-#include "DataFormats/Math/interface/deltaR.h"
 
 #include <functional>
+#include <memory>
+#include <cmath>
+#include <algorithm>
 
 FatJetsFiller::FatJetsFiller(std::string const& _name, edm::ParameterSet const& _cfg, edm::ConsumesCollector& _coll) :
   JetsFiller(_name, _cfg, _coll),
@@ -19,8 +21,16 @@ FatJetsFiller::FatJetsFiller(std::string const& _name, edm::ParameterSet const&
   subjetCmvaTag_(getParameter_<std::string>(_cfg, "subjetCmva", "")),
   subjetDeepCsvTag_(getParameter_<std::string>(_cfg, "subjetDeepCSV", "")),
   subjetDeepCmvaTag_(getParameter_<std::string>(_cfg, "subjetDeepCMVA", "")),
+  subjetGrid_(R_),
   activeArea_(7., 1, 0.01),
-  areaDef_(fastjet::active_area_explicit_ghosts, activeArea_)
+  areaDef_(fastjet::active_area_explicit_ghosts, activeArea_),
+  substructureMaxJets_(getParameter_<unsigned>(_cfg, "substructureMaxJets", 2)),
+  substructureMinPt_(getParameter_<double>(_cfg, "substructureMinPt", 0.)),
+  substructureMinMass_(getParameter_<double>(_cfg, "substructureMinMass", 0.)),
+  substructureMaxEta_(getParameter_<double>(_cfg, "substructureMaxEta", -1.)),
+  ecfMaxConstituents_(getParameter_<unsigned>(_cfg, "ecfMaxConstituents", 100)),
+  ecfTolerance_(getParameter_<double>(_cfg, "ecfTolerance", 0.)),
+  substructureArea_(getParameter_<bool>(_cfg, "substructureArea", false))
 {
   if (_name == "chsAK8Jets")
     outSubjetSelector_ = [](panda::Event& _event)->panda::MicroJetCollection& { return _event.chsAK8Subjets; };
@@ -35,6 +45,30 @@ FatJetsFiller::FatJetsFiller(std::string const& _name, edm::ParameterSet const&
 
   getToken_(subjetsToken_, _cfg, _coll, "subjets");
 
+  // resolve discriminator positions once instead of looking up the names for every jet
+  if (!shallowBBTagTag_.empty())
+    shallowBBTagKey_ = btagIndex_.add(shallowBBTagTag_);
+  if (!deepBBprobQTag_.empty())
+    deepBBprobQKey_ = btagIndex_.add(deepBBprobQTag_);
+  if (!deepBBprobHTag_.empty())
+    deepBBprobHKey_ = btagIndex_.add(deepBBprobHTag_);
+
+  if (!subjetBtagTag_.empty())
+    subjetBtagKey_ = subjetBTagIndex_.add(subjetBtagTag_);
+  if (!subjetCmvaTag_.empty())
+    subjetCmvaKey_ = subjetBTagIndex_.add(subjetCmvaTag_);
+  for (auto prob : deepProbs) {
+    if (!subjetDeepCsvTag_.empty())
+      subjetDeepCsvKeys_.emplace_back(prob.second, subjetBTagIndex_.add(subjetDeepCsvTag_ + ":prob" + prob.first));
+    if (!subjetDeepCmvaTag_.empty())
+      subjetDeepCmvaKeys_.emplace_back(prob.second + deepSuff::DEEP_SIZE, subjetBTagIndex_.add(subjetDeepCmvaTag_ + ":prob" + prob.first));
+  }
+
+  for (char const* tau : {":tau1", ":tau2", ":tau3"})
+    njettinessNames_.push_back(njettinessTag_ + tau);
+  sdMassName_ = sdKinematicsTag_ + ":Mass";
+  prunedMassName_ = prunedKinematicsTag_ + ":Mass";
+
   auto&& computeMode(getParameter_<std::string>(_cfg, "computeSubstructure", ""));
   if (computeMode == "always")
     computeSubstructure_ = kAlways;
@@ -43,15 +77,38 @@ FatJetsFiller::FatJetsFiller(std::string const& _name, edm::ParameterSet const&
   else
     computeSubstructure_ = kNever;
 
+  auto&& quantities(getParameter_<VString>(_cfg, "substructure", VString{"ecfs", "tauSD", "htt"}));
+  substructureMask_ = 0;
+  for (auto& q : quantities) {
+    if (q == "ecfs")
+      substructureMask_ |= kECF;
+    else if (q == "tauSD")
+      substructureMask_ |= kTauSD;
+    else if (q == "htt")
+      substructureMask_ |= kHTT;
+    else
+      throw edm::Exception(edm::errors::Configuration, "Unknown substructure quantity " + q);
+  }
+
+  if (substructureMask_ == 0 || substructureMaxJets_ == 0)
+    computeSubstructure_ = kNever;
+
   if (computeSubstructure_ == kLargeRecoil)
     getToken_(categoriesToken_, _cfg, _coll, "recoil");
 
   if (computeSubstructure_ != kNever) {
     jetDefCA_ = new fastjet::JetDefinition(fastjet::cambridge_algorithm, R_);
-    softdrop_ = new fastjet::contrib::SoftDrop(1., 0.15, R_);
-    ecfcalc_ = new pandaecf::Calculator();
-    tau_ = new fastjet::contrib::Njettiness(fastjet::contrib::OnePass_KT_Axes(), fastjet::contrib::NormalizedMeasure(1., R_));
+    if ((substructureMask_ & (kECF | kTauSD)) != 0)
+      softdrop_ = new fastjet::contrib::SoftDrop(1., 0.15, R_);
+    if ((substructureMask_ & kECF) != 0) {
+      ecfcalc_ = new pandaecf::Calculator();
+      ecfcalc_->setTolerance(ecfTolerance_);
+    }
+    if ((substructureMask_ & kTauSD) != 0)
+      tau_ = new fastjet::contrib::Njettiness(fastjet::contrib::OnePass_KT_Axes(), fastjet::contrib::NormalizedMeasure(1., R_));
+  }
 
+  if (computeSubstructure_ != kNever && (substructureMask_ & kHTT) != 0) {
     //htt
     bool optimalR=true; bool doHTTQ=false;
     double minSJPt=0.; double minCandPt=0.;
@@ -69,6 +126,11 @@ FatJetsFiller::FatJetsFiller(std::string const& _name, edm::ParameterSet const&
                                         maxCandMass,massRatioWidth,
                                         minM23Cut,minM13Cut,
                                         maxM13Cut,rejectMinR);
+    // subjets that survive a step of the optimal-R scan are not rerun; set httReuseSubjets = False to
+    // compare against the full rerun
+    htt_->setReuseSubjets(getParameter_<bool>(_cfg, "httReuseSubjets", true));
+    // only top_mass and fRec are stored
+    htt_->setComputeNsubjettiness(false);
   }
 }
 
@@ -92,18 +154,40 @@ FatJetsFiller::branchNames(panda::utils::BranchList& _eventBranches, panda::util
   subjetName.ReplaceAll("Jets", "Subjets");
   _eventBranches.emplace_back(subjetName);
 
-  if (computeSubstructure_ == kNever) {
-    char const* substrBranches[] = {
-      ".tau1SD",
-      ".tau2SD",
-      ".tau3SD",
-      ".htt_mass",
-      ".htt_frec",
-      ".ecfs"
-    };
-    for (char const* b : substrBranches)
+  unsigned mask(computeSubstructure_ == kNever ? 0 : substructureMask_);
+
+  if ((mask & kTauSD) == 0) {
+    for (char const* b : {".tau1SD", ".tau2SD", ".tau3SD"})
+      _eventBranches.emplace_back("!" + getName() + b);
+  }
+  if ((mask & kHTT) == 0) {
+    for (char const* b : {".htt_mass", ".htt_frec"})
       _eventBranches.emplace_back("!" + getName() + b);
   }
+  if ((mask & kECF) == 0)
+    _eventBranches.emplace_back("!" + getName() + ".ecfs");
+}
+
+void
+FatJetsFiller::addOutput(TFile& _outputFile)
+{
+  if (ecfcalc_ && ecfTolerance_ > 0.) {
+    hECFTruncation_ = new TH1D((getName() + "ECFTruncation").c_str(), "log_{10} ECF truncation error bound", 100, -10., 1.);
+    hECFTruncation_->SetDirectory(&_outputFile);
+  }
+}
+
+bool
+FatJetsFiller::passSubstructurePreselection_(pat::Jet const& _inJet) const
+{
+  if (_inJet.pt() < substructureMinPt_)
+    return false;
+  if (_inJet.mass() < substructureMinMass_)
+    return false;
+  if (substructureMaxEta_ >= 0. && std::abs(_inJet.eta()) > substructureMaxEta_)
+    return false;
+
+  return true;
 }
 
 void
@@ -120,7 +204,25 @@ FatJetsFiller::fillDetails_(panda::Event& _outEvent, edm::Event const& _inEvent,
 
   auto& jetMap(objectMap_->get<reco::Jet, panda::Jet>());
 
-  unsigned iJ(0);
+  // number of jets for which substructure was computed
+  unsigned nSubstructure(0);
+
+  // subjets are binned once per event; cone matching then only looks at nearby cells
+  subjetGrid_.clear();
+  for (auto& inSubjet : inSubjets)
+    subjetGrid_.add(inSubjet.eta(), inSubjet.phi());
+  subjetGrid_.build();
+
+  // index in outSubjets of the first output copy of each input subjet
+  // a subjet falling into several fat-jet cones is filled once and copied afterwards
+  ArenaVector<int> firstOutSubjet(inSubjets.size(), -1, arena_);
+
+  for (auto& inSubjet : inSubjets) {
+    if (dynamic_cast<pat::Jet const*>(&inSubjet)) {
+      subjetBTagIndex_.update(static_cast<pat::Jet const&>(inSubjet));
+      break;
+    }
+  }
 
   for (auto& link : jetMap.bwdMap) { // panda -> edm
     auto& outJet(static_cast<panda::FatJet&>(*link.first));
@@ -128,52 +230,53 @@ FatJetsFiller::fillDetails_(panda::Event& _outEvent, edm::Event const& _inEvent,
     if (dynamic_cast<pat::Jet const*>(link.second.get())) {
       auto& inJet(static_cast<pat::Jet const&>(*link.second));
 
-      outJet.tau1 = inJet.userFloat(njettinessTag_ + ":tau1");
-      outJet.tau2 = inJet.userFloat(njettinessTag_ + ":tau2");
-      outJet.tau3 = inJet.userFloat(njettinessTag_ + ":tau3");
-      outJet.mSD  = inJet.userFloat(sdKinematicsTag_ + ":Mass");
-      outJet.mPruned = inJet.userFloat(prunedKinematicsTag_ + ":Mass");
+      outJet.tau1 = inJet.userFloat(njettinessNames_[0]);
+      outJet.tau2 = inJet.userFloat(njettinessNames_[1]);
+      outJet.tau3 = inJet.userFloat(njettinessNames_[2]);
+      outJet.mSD  = inJet.userFloat(sdMassName_);
+      outJet.mPruned = inJet.userFloat(prunedMassName_);
 
+      // btagIndex_ is validated against the first jet of the event in JetsFiller::fill
       if (!shallowBBTagTag_.empty())
-        outJet.double_sub = inJet.bDiscriminator(shallowBBTagTag_);
+        outJet.double_sub = btagIndex_.get(inJet, shallowBBTagKey_);
       if (!deepBBprobQTag_.empty())
-        outJet.deepBBprobQ = inJet.bDiscriminator(deepBBprobQTag_);
+        outJet.deepBBprobQ = btagIndex_.get(inJet, deepBBprobQKey_);
       if (!deepBBprobHTag_.empty())
-        outJet.deepBBprobH = inJet.bDiscriminator(deepBBprobHTag_);
+        outJet.deepBBprobH = btagIndex_.get(inJet, deepBBprobHKey_);
 
-      for (auto& inSubjet : inSubjets) {
-        if (reco::deltaR(inSubjet.eta(), inSubjet.phi(), inJet.eta(), inJet.phi()) > R_) 
-          continue;
+      subjetGrid_.forEachNear(inJet.eta(), inJet.phi(), R_, [&](unsigned iS, double) {
+        auto& inSubjet(inSubjets[iS]);
 
         auto& outSubjet(outSubjets.create_back());
 
+        if (firstOutSubjet[iS] >= 0) {
+          outSubjet = outSubjets[firstOutSubjet[iS]];
+          outJet.subjets.addRef(&outSubjet);
+          return;
+        }
+
+        firstOutSubjet[iS] = outSubjets.size() - 1;
+
         fillP4(outSubjet, inSubjet);
 
         if (dynamic_cast<pat::Jet const*>(&inSubjet)) {
           auto& patSubjet(dynamic_cast<pat::Jet const&>(inSubjet));
           if (!subjetBtagTag_.empty())
-            outSubjet.csv = patSubjet.bDiscriminator(subjetBtagTag_);
+            outSubjet.csv = subjetBTagIndex_.get(patSubjet, subjetBtagKey_);
           if (!subjetCmvaTag_.empty())
-            outSubjet.cmva = patSubjet.bDiscriminator(subjetCmvaTag_);
+            outSubjet.cmva = subjetBTagIndex_.get(patSubjet, subjetCmvaKey_);
           if (!subjetQGLTag_.empty() && patSubjet.hasUserFloat(subjetQGLTag_))
             outSubjet.qgl = patSubjet.userFloat(subjetQGLTag_);
 
-          if (!subjetDeepCsvTag_.empty()) {
-            for (auto prob : deepProbs) {
-              fillDeepBySwitch_(outSubjet, prob.second, patSubjet.bDiscriminator(subjetDeepCsvTag_ + ":prob" + prob.first));
-            }
-          }
-
-          if (!subjetDeepCmvaTag_.empty()) {
-            for (auto prob : deepProbs) {
-              fillDeepBySwitch_(outSubjet, prob.second + deepSuff::DEEP_SIZE, patSubjet.bDiscriminator(subjetDeepCmvaTag_ + ":prob" + prob.first));
-            }
-          }
+          for (auto& key : subjetDeepCsvKeys_)
+            fillDeepBySwitch_(outSubjet, key.first, subjetBTagIndex_.get(patSubjet, key.second));
+          for (auto& key : subjetDeepCmvaKeys_)
+            fillDeepBySwitch_(outSubjet, key.first, subjetBTagIndex_.get(patSubjet, key.second));
 
         }
 
         outJet.subjets.addRef(&outSubjet);
-      }
+      });
 
       // reset the ECFs
       for (unsigned iB(0); iB != 4; ++iB) {
@@ -184,10 +287,9 @@ FatJetsFiller::fillDetails_(panda::Event& _outEvent, edm::Event const& _inEvent,
         }
       }
 
-      if (doSubstructure && iJ < 2) {
-        // either we want to associate to pf cands OR compute extra info about the first or second jet
-        // but do not do any of this if ReduceEvent() is tripped
-        // only filled for first two fat jets
+      if (doSubstructure && nSubstructure < substructureMaxJets_ && passSubstructurePreselection_(inJet)) {
+        // compute extra info only for the leading jets passing the preselection
+        ++nSubstructure;
 
         // calculate ECFs, groomed tauN
         VPseudoJet vjet;
@@ -200,49 +302,66 @@ FatJetsFiller::fillDetails_(panda::Event& _outEvent, edm::Event const& _inEvent,
           vjet.emplace_back(cand.px(), cand.py(), cand.pz(), cand.energy());
         }
 
-        fastjet::ClusterSequenceArea seq(vjet, *jetDefCA_, areaDef_);
-        VPseudoJet alljets(fastjet::sorted_by_pt(seq.inclusive_jets(0.1)));
+        // none of the substructure quantities uses the jet area; ghosts are only added on request
+        std::unique_ptr<fastjet::ClusterSequence> seq;
+        if (substructureArea_)
+          seq.reset(new fastjet::ClusterSequenceArea(vjet, *jetDefCA_, areaDef_));
+        else
+          seq.reset(new fastjet::ClusterSequence(vjet, *jetDefCA_));
+
+        VPseudoJet alljets(fastjet::sorted_by_pt(seq->inclusive_jets(0.1)));
 
         if (alljets.size() > 0){
           fastjet::PseudoJet& leadingJet(alljets[0]);
-          fastjet::PseudoJet sdJet((*softdrop_)(leadingJet));
-
-          // get and filter constituents of groomed jet
-          VPseudoJet sdconsts(fastjet::sorted_by_pt(sdJet.constituents()));
-          unsigned nFilter(std::min(100, int(sdconsts.size())));
-          VPseudoJet sdconstsFiltered(sdconsts.begin(), sdconsts.begin() + nFilter);
-
-          // calculate ECFs
-          ecfcalc_->calculate(sdconstsFiltered);
-          for (auto iter = ecfcalc_->begin(); iter != ecfcalc_->end(); ++iter) {
-            int oI = iter.get<pandaecf::Calculator::oP>() + 1;
-            int nI = iter.get<pandaecf::Calculator::nP>() + 1;
-            int bI = iter.get<pandaecf::Calculator::bP>();
-            bool success = outJet.set_ecf(oI, nI, bI,
-                                          static_cast<float>(iter.get<pandaecf::Calculator::ecfP>()));
-            if (!success)
-              throw std::runtime_error(
-                  TString::Format("FatJetsFiller Could not save oI=%i, nI=%i, bI=%i", oI, nI, bI).Data());
-          }
 
-          outJet.tau3SD = tau_->getTau(3, sdconsts);
-          outJet.tau2SD = tau_->getTau(2, sdconsts);
-          outJet.tau1SD = tau_->getTau(1, sdconsts);
+          if (softdrop_) {
+            fastjet::PseudoJet sdJet((*softdrop_)(leadingJet));
+
+            // get constituents of groomed jet
+            VPseudoJet sdconsts(fastjet::sorted_by_pt(sdJet.constituents()));
+
+            // calculate ECFs on the leading constituents
+            if (ecfcalc_) {
+              unsigned nFilter(std::min(ecfMaxConstituents_, unsigned(sdconsts.size())));
+              VPseudoJet sdconstsFiltered(sdconsts.begin(), sdconsts.begin() + nFilter);
+
+              ecfcalc_->calculate(sdconstsFiltered);
+              for (auto iter = ecfcalc_->begin(); iter != ecfcalc_->end(); ++iter) {
+                int oI = iter.get<pandaecf::Calculator::oP>() + 1;
+                int nI = iter.get<pandaecf::Calculator::nP>() + 1;
+                int bI = iter.get<pandaecf::Calculator::bP>();
+                bool success = outJet.set_ecf(oI, nI, bI,
+                                              static_cast<float>(iter.get<pandaecf::Calculator::ecfP>()));
+                if (!success)
+                  throw std::runtime_error(
+                      TString::Format("FatJetsFiller Could not save oI=%i, nI=%i, bI=%i", oI, nI, bI).Data());
+              }
+
+              if (hECFTruncation_)
+                hECFTruncation_->Fill(std::log10(std::max(ecfcalc_->maxTruncationError(), 1.e-10)));
+            }
+
+            if (tau_) {
+              outJet.tau3SD = tau_->getTau(3, sdconsts);
+              outJet.tau2SD = tau_->getTau(2, sdconsts);
+              outJet.tau1SD = tau_->getTau(1, sdconsts);
+            }
+          }
 
           // HTT
-          fastjet::PseudoJet httJet(htt_->result(leadingJet));
-          if (httJet != 0) {
-            auto* s(static_cast<fastjet::HEPTopTaggerV2Structure*>(httJet.structure_non_const_ptr()));
-            outJet.htt_mass = s->top_mass();
-            outJet.htt_frec = s->fRec();
+          if (htt_) {
+            fastjet::PseudoJet httJet(htt_->result(leadingJet));
+            if (httJet != 0) {
+              auto* s(static_cast<fastjet::HEPTopTaggerV2Structure*>(httJet.structure_non_const_ptr()));
+              outJet.htt_mass = s->top_mass();
+              outJet.htt_frec = s->fRec();
+            }
           }
         }
         else
           throw std::runtime_error("PandaProd::FatJetsFiller: Jet could not be clustered");
       } // if computeSubstructure_
     }
-
-    ++iJ;
   }
 }
 
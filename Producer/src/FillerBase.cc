@@ -8,6 +8,26 @@ FillerBase::FillerBase(std::string const& _fillerName, edm::ParameterSet const&
 {
 }
 
+PFCandidateIndex const&
+FillerBase::getPFCandidateIndex_(edm::Event const& _event)
+{
+  if (!pfCandidateIndex_)
+    throw edm::Exception(edm::errors::Configuration, getName() + "::getPFCandidateIndex_()")
+      << "PF candidate index requested but fillers.common.pfCandidates is not set";
+
+  return pfCandidateIndex_->get(_event);
+}
+
+GenParticleIndex const&
+FillerBase::getGenParticleIndex_(edm::Event const& _event)
+{
+  if (!genParticleIndex_)
+    throw edm::Exception(edm::errors::Configuration, getName() + "::getGenParticleIndex_()")
+      << "Gen particle index requested but fillers.common.genParticles is not set";
+
+  return genParticleIndex_->get(_event);
+}
+
 void
 fillP4(panda::Particle& _out, reco::Candidate const& _in)
 {
@@ -0,0 +1,109 @@
+#include "../interface/FillerScheduler.h"
+
+#include "tbb/task_group.h"
+
+#include <set>
+#include <atomic>
+#include <memory>
+
+FillerScheduler::FillerScheduler(std::vector<FillerBase*> const& _fillers)
+{
+  unsigned nF(_fillers.size());
+
+  std::vector<std::set<std::string>> reads[nSteps];
+  std::vector<std::set<std::string>> writes[nSteps];
+
+  for (unsigned iS(0); iS != nSteps; ++iS) {
+    reads[iS].resize(nF);
+    writes[iS].resize(nF);
+    successors_[iS].assign(nF, std::vector<unsigned>());
+    nPredecessors_[iS].assign(nF, 0);
+  }
+
+  for (unsigned iF(0); iF != nF; ++iF) {
+    auto* filler(_fillers[iF]);
+    names_.push_back(filler->getName());
+
+    FillerAccess access[nSteps];
+    filler->declareAccess(access[kFill], access[kSetRefs]);
+
+    for (unsigned iS(0); iS != nSteps; ++iS) {
+      reads[iS][iF].insert(access[iS].reads.begin(), access[iS].reads.end());
+      writes[iS][iF].insert(access[iS].writes.begin(), access[iS].writes.end());
+      writes[iS][iF].insert(filler->getName());
+    }
+  }
+
+  auto intersects([](std::set<std::string> const& s1, std::set<std::string> const& s2)->bool {
+      for (auto& name : s1) {
+        if (s2.count(name) != 0)
+          return true;
+      }
+      return false;
+    });
+
+  for (unsigned iS(0); iS != nSteps; ++iS) {
+    for (unsigned iF(0); iF != nF; ++iF) {
+      for (unsigned jF(iF + 1); jF != nF; ++jF) {
+        if (intersects(writes[iS][iF], writes[iS][jF]) ||
+            intersects(writes[iS][iF], reads[iS][jF]) ||
+            intersects(reads[iS][iF], writes[iS][jF])) {
+          successors_[iS][iF].push_back(jF);
+          ++nPredecessors_[iS][jF];
+        }
+      }
+    }
+  }
+}
+
+void
+FillerScheduler::run(Step _step, Task const& _task) const
+{
+  auto& successors(successors_[_step]);
+  auto& nPredecessors(nPredecessors_[_step]);
+  unsigned nF(nPredecessors.size());
+
+  std::unique_ptr<std::atomic<unsigned>[]> nWaiting(new std::atomic<unsigned>[nF]);
+  for (unsigned iF(0); iF != nF; ++iF)
+    nWaiting[iF] = nPredecessors[iF];
+
+  tbb::task_group group;
+
+  // Execute a filler and spawn the successors that have no more pending predecessors.
+  // If a task throws, the group is cancelled and the exception is rethrown from wait().
+  std::function<void(unsigned)> execute;
+  execute = [&](unsigned iF) {
+    _task(iF);
+
+    for (unsigned jF : successors[iF]) {
+      if (--nWaiting[jF] == 0)
+        group.run([&execute, jF]() { execute(jF); });
+    }
+  };
+
+  for (unsigned iF(0); iF != nF; ++iF) {
+    if (nPredecessors[iF] == 0)
+      group.run([&execute, iF]() { execute(iF); });
+  }
+
+  group.wait();
+}
+
+void
+FillerScheduler::print(std::ostream& _out) const
+{
+  char const* stepNames[nSteps] = {"fill", "setRefs"};
+
+  for (unsigned iS(0); iS != nSteps; ++iS) {
+    _out << " " << stepNames[iS] << ":" << std::endl;
+    for (unsigned iF(0); iF != names_.size(); ++iF) {
+      _out << "  " << names_[iF];
+      if (!successors_[iS][iF].empty()) {
+        _out << " ->";
+        for (unsigned jF : successors_[iS][iF])
+          _out << " " << names_[jF];
+      }
+      _out << std::endl;
+    }
+  }
+}
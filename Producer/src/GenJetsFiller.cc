@@ -9,7 +9,6 @@ GenJetsFiller::GenJetsFiller(std::string const& _name, edm::ParameterSet const&
 {
   getToken_(genJetsToken_, _cfg, _coll, "genJets");
   getToken_(flavorToken_, _cfg, _coll, "flavor");
-  getToken_(genParticlesToken_, _cfg, _coll, "common", "genParticles");
   
   getToken_(genBHadPlusMothersToken_       , _cfg, _coll, "genBHadPlusMothers"        , false);
   //getToken_(genBHadPlusMothersIndicesToken_, _cfg, _coll, "genBHadPlusMothersIndices" , false);
@@ -49,12 +48,17 @@ GenJetsFiller::branchNames(panda::utils::BranchList& _eventBranches, panda::util
   _eventBranches.emplace_back(getName());
 }
 
+void
+GenJetsFiller::declareAccess(FillerAccess&, FillerAccess& _setRefsAccess) const
+{
+  _setRefsAccess.reads.emplace_back("genParticles");
+}
+
 void
 GenJetsFiller::fill(panda::Event& _outEvent, edm::Event const& _inEvent, edm::EventSetup const&)
 {
   auto& inJets(getProduct_(_inEvent, genJetsToken_));
   auto& inFlavor(getProduct_(_inEvent, flavorToken_));
-  auto& inParticles(getProduct_(_inEvent, genParticlesToken_));
   
   auto *genBHadPlusMothers       (getProductSafe_(_inEvent, genBHadPlusMothersToken_       ));
   //auto *genBHadPlusMothersIndices(getProductSafe_(_inEvent, genBHadPlusMothersIndicesToken_));
@@ -81,47 +85,30 @@ GenJetsFiller::fill(panda::Event& _outEvent, edm::Event const& _inEvent, edm::Ev
   std::vector<std::vector<reco::CandidatePtr>> genBHadrons;
   std::vector<std::vector<reco::CandidatePtr>> genCHadrons;
 
-  if (genBHadJetIndex != nullptr) {
-    genBHadrons.resize(inJets.size());
-
-    for (unsigned genBHad=0; genBHad<genBHadJetIndex->size(); genBHad++) {
-      unsigned jetIndex = genBHadJetIndex->at(genBHad);
-      unsigned hadIndex = genBHadIndex->at(genBHad);
-      reco::GenParticle const& genHadron(genBHadPlusMothers->at(hadIndex)); // (duplicated) gen particle hadron mother
-
-      // Find the corresponding pointer in the true gen particle collection
-      for (unsigned iP(0); iP != inParticles.size(); ++iP) {
-        auto& inCand(inParticles.at(iP));
-        if (inCand.pdgId()              == genHadron.pdgId() &&
-            inCand.statusFlags().flags_ == genHadron.statusFlags().flags_ &&
-            inCand.p4()                 == genHadron.p4()) {
-          genBHadrons[jetIndex].emplace_back(inParticles.ptrAt(iP));
-          break;
-        }
-      }
-    }
-  }
+  // Find the hadrons (duplicated gen particles) in the true gen particle collection
+  auto findHadrons([this, &_inEvent, &inJets](std::vector<int> const& _jetIndex, std::vector<int> const& _hadIndex, std::vector<reco::GenParticle> const& _hadPlusMothers, std::vector<std::vector<reco::CandidatePtr>>& _hadrons) {
+      auto& genIndex(getGenParticleIndex_(_inEvent));
 
-  if (genCHadJetIndex != nullptr) {
-    genCHadrons.resize(inJets.size());
-
-    for (unsigned genCHad=0; genCHad<genCHadJetIndex->size(); genCHad++) {
-      unsigned jetIndex = genCHadJetIndex->at(genCHad);
-      unsigned hadIndex = genCHadIndex->at(genCHad);
-      reco::GenParticle const& genHadron(genCHadPlusMothers->at(hadIndex)); // (duplicated) gen particle hadron mother
-
-      // Find the corresponding pointer in the true gen particle collection
-      for (unsigned iP(0); iP != inParticles.size(); ++iP) {
-        auto& inCand(inParticles.at(iP));
-        if (inCand.pdgId()              == genHadron.pdgId() &&
-            inCand.statusFlags().flags_ == genHadron.statusFlags().flags_ &&
-            inCand.p4()                 == genHadron.p4()) {
-          genCHadrons[jetIndex].emplace_back(inParticles.ptrAt(iP));
-          break;
-        }
+      _hadrons.resize(inJets.size());
+
+      for (unsigned iHad(0); iHad != _jetIndex.size(); ++iHad) {
+        int jetIndex(_jetIndex[iHad]);
+        if (jetIndex < 0) // hadron not clustered into any jet
+          continue;
+
+        reco::GenParticle const& genHadron(_hadPlusMothers.at(_hadIndex.at(iHad))); // (duplicated) gen particle hadron mother
+
+        int iP(genIndex.find(genHadron));
+        if (iP >= 0)
+          _hadrons.at(jetIndex).emplace_back(genIndex.ptrAt(iP));
       }
-    }
-  }
+    });
+
+  if (genBHadJetIndex != nullptr)
+    findHadrons(*genBHadJetIndex, *genBHadIndex, *genBHadPlusMothers, genBHadrons);
+
+  if (genCHadJetIndex != nullptr)
+    findHadrons(*genCHadJetIndex, *genCHadIndex, *genCHadPlusMothers, genCHadrons);
 
   auto& outJets(outputSelector_(_outEvent));
 
@@ -0,0 +1,64 @@
+#include "../interface/GenParticleIndex.h"
+
+#include <cstring>
+#include <cmath>
+
+GenParticleIndex::Key::Key(reco::GenParticle const& _part) :
+  pdgId(_part.pdgId()),
+  flags(_part.statusFlags().flags_.to_ulong())
+{
+  auto&& mom(_part.p4());
+  double values[4] = {mom.px(), mom.py(), mom.pz(), mom.energy()};
+  for (unsigned iX(0); iX != 4; ++iX) {
+    // +0. and -0. compare equal; give them the same bit pattern
+    double x(values[iX] + 0.);
+    std::memcpy(p4 + iX, &x, sizeof(double));
+  }
+}
+
+bool
+GenParticleIndex::Key::operator==(Key const& _rhs) const
+{
+  return pdgId == _rhs.pdgId && flags == _rhs.flags && std::memcmp(p4, _rhs.p4, sizeof(p4)) == 0;
+}
+
+std::size_t
+GenParticleIndex::KeyHash::operator()(Key const& _key) const
+{
+  std::uint64_t h(std::uint64_t(std::uint32_t(_key.pdgId)) | (std::uint64_t(_key.flags) << 32));
+  for (auto x : _key.p4)
+    h = (h ^ x) * 0x100000001b3ULL + (h >> 29);
+
+  return h;
+}
+
+int
+GenParticleIndex::find(reco::GenParticle const& _part) const
+{
+  auto itr(index_.find(Key(_part)));
+  if (itr == index_.end())
+    return -1;
+
+  return itr->second;
+}
+
+void
+GenParticleIndex::build_(edm::Event const& _event)
+{
+  particles_ = &getProduct_(_event, token_, "fillers.common.genParticles");
+
+  index_.clear();
+  index_.reserve(particles_->size());
+
+  for (unsigned iP(0); iP != particles_->size(); ++iP) {
+    auto& part(particles_->at(iP));
+
+    // NaN never compares equal to anything; such particles cannot be matched by value
+    auto&& mom(part.p4());
+    if (std::isnan(mom.px()) || std::isnan(mom.py()) || std::isnan(mom.pz()) || std::isnan(mom.energy()))
+      continue;
+
+    // emplace keeps the lowest index among identical particles
+    index_.emplace(Key(part), iP);
+  }
+}
@@ -8,13 +8,12 @@
 #include "PandaProd/Auxiliary/interface/PackedValuesExposer.h"
 #include "PandaTree/Utils/interface/PNode.h"
 
+#include <stdexcept>
+
 typedef edm::Ptr<reco::GenParticle> GenParticlePtr;
 typedef edm::Ptr<pat::PackedGenParticle> PackedGenParticlePtr;
 
-namespace {
-  // Track the PNodeWithPtrs that are made from packed collections
-  std::unordered_set<const void*> miniaodPacked;
-}
+class GenNodeIndex;
 
 struct PNodeWithPtr : public PNode {
   reco::CandidatePtr candPtr{};
@@ -22,132 +21,15 @@ struct PNodeWithPtr : public PNode {
   uint16_t packedPt{0xffff};
   uint16_t packedPhi{0xffff};
   uint16_t packedM{0xffff};
+  //! Node is made from the packed (final state) collection
+  bool miniaodPacked{false};
+  //! Node is part of the current event's tree (slots of the node vector are reused across events)
+  bool inTree{false};
 
-  PNodeWithPtr(GenParticlePtr const& _ptr, std::map<reco::CandidatePtr, PNodeWithPtr*>& _nodeMap, PNode* _mother = 0) {
-    auto& inCand(*_ptr);
-    pdgId = inCand.pdgId();
-    status = inCand.status();
-    statusBits = inCand.statusFlags().flags_;
-    mass = inCand.mass();
-    pt = inCand.pt();
-    eta = inCand.eta();
-    phi = inCand.phi();
-    mother = _mother;
-
-    ownDaughters = false;
-
-    candPtr = _ptr;
-
-    _nodeMap[candPtr] = this;
-
-    for (auto& dref : inCand.daughterRefVector()) {
-      GenParticlePtr dptr(edm::refToPtr(dref));
-
-      auto nItr(_nodeMap.find(dptr));
-
-      if (nItr != _nodeMap.end()) {
-        // this node is already constructed
-
-        PNode* dnode(nItr->second);
-
-        // protect against cyclic graphs - is dnode my ancestor?
-        PNode* p(this);
-        while (p) {
-          if (p == dnode)
-            break;
-          p = p->mother;
-        }
-        if (p) // one of my ancestors is dnode; don't add this node as my daughter
-          continue;
-
-        PNode* dmother(dnode->mother);
-
-        if (dmother) {
-          // and it's someone's daughter
-
-          if (dmother == this) // mine!?
-            continue;
-
-          bool takeCustody(false);
-          if (!isHadronic() && dmother->isHadronic())
-            takeCustody = true;
-          else if (isHadronic() && !dmother->isHadronic())
-            takeCustody = false;
-          else
-            takeCustody = reco::deltaR2(eta, phi, dnode->eta, dnode->phi) < reco::deltaR2(dmother->eta, dmother->phi, dnode->eta, dnode->phi);
-
-          if (takeCustody) {
-            dnode->mother = this;
-            daughters.push_back(dnode);
-            std::vector<PNode*>::iterator dItr(std::find(dmother->daughters.begin(), dmother->daughters.end(), dnode));
-            if (dItr != dmother->daughters.end()) // can happen that this daughter is still being pushed into mother's daughter list
-              dmother->daughters.erase(dItr);
-          }
-        }
-        else {
-          dnode->mother = this;
-          daughters.push_back(dnode);
-        }
-      }
-      else
-        daughters.push_back(new PNodeWithPtr(dptr, _nodeMap, this));
-    }
-  }
-
-  PNodeWithPtr(PackedGenParticlePtr const& _ptr, std::map<reco::CandidatePtr, PNodeWithPtr*>& _nodeMap) {
-    auto& inCand(*_ptr);
-    pdgId = inCand.pdgId();
-    status = 1;
-    mass = inCand.mass();
-    pt = inCand.pt();
-    eta = inCand.eta();
-    phi = inCand.phi();
-
-    PackedGenParticleExposer exposer(inCand);
-    packedPt = exposer.packedPt();
-    packedPhi = exposer.packedPhi();
-    packedM = exposer.packedM();
-
-    candPtr = _ptr;
-    // don't really need to add this to nodeMap, but makes it easy to delete the nodes later
-    _nodeMap[candPtr] = this;
-
-    auto motherRef(inCand.motherRef());
-    if (motherRef.isNonnull()) {
-      mother = _nodeMap.at(reco::CandidatePtr(edm::refToPtr(motherRef)));
-
-      // kick out the existing daughter
-      unsigned iD(0);
-      for (; iD != mother->daughters.size(); ++iD) {
-        auto* d(mother->daughters[iD]);
-
-        double dpt(std::abs(d->pt - pt));
-        if (pt == 0. && dpt > 0.1)
-          continue;
-
-        if (d->pdgId == pdgId && d->status == 1 && reco::deltaR2(d->eta, d->phi, eta, phi) < 0.0001 && dpt / pt < 0.05) {
-          // found a matching candidate, kick it out
-          mother->daughters[iD] = this;
-          replacedCandPtr = static_cast<PNodeWithPtr*>(d)->candPtr;
-
-          if (dynamic_cast<reco::GenParticle const*>(&*replacedCandPtr)) {
-            GenParticlePtr genP(replacedCandPtr);
-            if (replacedCandPtr.isNonnull())
-              statusBits = genP->statusFlags().flags_;
-          }
-
-          delete d;
-          _nodeMap.erase(replacedCandPtr);
-          break;
-        }
-      }
-
-      if (iD == mother->daughters.size()) {
-        // no one was impersonating me
-        mother->daughters.push_back(this);
-      }
-    }
-  }
+  //! Reset the slot, keeping the capacity of the daughters vector
+  void clear();
+  void set(GenParticlePtr const&, GenNodeIndex&, PNode* mother = 0);
+  void set(PackedGenParticlePtr const&, GenNodeIndex&);
 
   void fillPanda(panda::GenParticleCollection& _outParticles, ObjectMap<reco::Candidate, panda::GenParticle>& _map, int parentIdx = -1) const {
     auto& outParticle(_outParticles.create_back());
@@ -165,7 +47,7 @@ struct PNodeWithPtr : public PNode {
 
     outParticle.pdgid = pdgId;
     outParticle.finalState = (status == 1);
-    outParticle.miniaodPacked = (miniaodPacked.find(this) != miniaodPacked.end());
+    outParticle.miniaodPacked = miniaodPacked;
     outParticle.statusFlags = statusBits.to_ulong();
     outParticle.parent.idx() = parentIdx;
 
@@ -186,7 +68,7 @@ struct PNodeWithPtr : public PNode {
 
     outParticle.pdgid = pdgId;
     outParticle.finalState = (status == 1);
-    outParticle.miniaodPacked = (miniaodPacked.find(this) != miniaodPacked.end());
+    outParticle.miniaodPacked = miniaodPacked;
     outParticle.statusFlags = statusBits.to_ulong();
     outParticle.parent.idx() = parentIdx;
 
@@ -195,6 +77,247 @@ struct PNodeWithPtr : public PNode {
   }
 };
 
+//! Node lookup for one event
+/*!
+ * Nodes of the gen particles are stored in the filler's node vector at their index in the input view,
+ * followed by the nodes of the packed particles. Refs are resolved to nodes through their key in the gen
+ * particle product. Particles reached through refs but not in the view (not expected with the standard
+ * inputs) get arena-allocated nodes.
+ */
+class GenNodeIndex {
+ public:
+  GenNodeIndex(std::vector<PNodeWithPtr>& _nodes, edm::View<reco::GenParticle> const& _inParticles, unsigned _nPacked, EventArena& _arena) :
+    nodes_(_nodes),
+    nGen_(_inParticles.size()),
+    keyToNode_(_arena),
+    extraNodes_(_arena)
+  {
+    // pointers to the nodes are held during the event; the vector must not reallocate after this point
+    if (nodes_.size() < nGen_ + _nPacked)
+      nodes_.resize(nGen_ + _nPacked);
+    for (unsigned iN(0); iN != nGen_ + _nPacked; ++iN)
+      nodes_[iN].clear();
+
+    for (unsigned iP(0); iP != nGen_; ++iP) {
+      auto ref(_inParticles.refAt(iP));
+      if (iP == 0)
+        genId_ = ref.id();
+      if (ref.id() != genId_)
+        continue;
+      if (ref.key() >= keyToNode_.size())
+        keyToNode_.resize(ref.key() + 1, -1);
+      keyToNode_[ref.key()] = iP;
+    }
+  }
+
+  ~GenNodeIndex()
+  {
+    for (auto& node : extraNodes_)
+      node.second->~PNodeWithPtr();
+  }
+
+  //! Node of the gen particle if it is in the tree, otherwise null
+  PNodeWithPtr* find(reco::CandidatePtr const& _ptr)
+  {
+    int iN(nodeIndex_(_ptr));
+    if (iN >= 0)
+      return nodes_[iN].inTree ? &nodes_[iN] : nullptr;
+
+    auto itr(extraNodes_.find(_ptr));
+    if (itr == extraNodes_.end() || !itr->second->inTree)
+      return nullptr;
+    return itr->second;
+  }
+
+  //! Build the node of a gen particle (and its descendants)
+  PNodeWithPtr* make(GenParticlePtr const& _ptr, PNode* _mother = 0)
+  {
+    PNodeWithPtr* node(nullptr);
+
+    int iN(nodeIndex_(_ptr));
+    if (iN >= 0)
+      node = &nodes_[iN];
+    else {
+      auto& extra(extraNodes_[_ptr]);
+      if (!extra)
+        extra = extraNodes_.get_allocator().arena()->make<PNodeWithPtr>();
+      node = extra;
+    }
+
+    node->clear();
+    node->set(_ptr, *this, _mother);
+    return node;
+  }
+
+  //! Build the node of the packed particle iP
+  PNodeWithPtr* make(PackedGenParticlePtr const& _ptr, unsigned _iP)
+  {
+    auto* node(&nodes_[nGen_ + _iP]);
+    node->set(_ptr, *this);
+    return node;
+  }
+
+ private:
+  int nodeIndex_(reco::CandidatePtr const& _ptr) const
+  {
+    if (_ptr.id() != genId_ || _ptr.key() >= keyToNode_.size())
+      return -1;
+    return keyToNode_[_ptr.key()];
+  }
+
+  std::vector<PNodeWithPtr>& nodes_;
+  unsigned const nGen_;
+  edm::ProductID genId_{};
+  ArenaVector<int> keyToNode_;
+  ArenaMap<reco::CandidatePtr, PNodeWithPtr*> extraNodes_;
+};
+
+void
+PNodeWithPtr::clear()
+{
+  // copy-assigning a default node resets all PNode fields; daughters keeps its storage
+  static PNode const emptyNode;
+  static_cast<PNode&>(*this) = emptyNode;
+  ownDaughters = false;
+  candPtr = reco::CandidatePtr();
+  replacedCandPtr = reco::CandidatePtr();
+  packedPt = 0xffff;
+  packedPhi = 0xffff;
+  packedM = 0xffff;
+  miniaodPacked = false;
+  inTree = false;
+}
+
+void
+PNodeWithPtr::set(GenParticlePtr const& _ptr, GenNodeIndex& _index, PNode* _mother/* = 0*/)
+{
+  auto& inCand(*_ptr);
+  pdgId = inCand.pdgId();
+  status = inCand.status();
+  statusBits = inCand.statusFlags().flags_;
+  mass = inCand.mass();
+  pt = inCand.pt();
+  eta = inCand.eta();
+  phi = inCand.phi();
+  mother = _mother;
+
+  ownDaughters = false;
+
+  candPtr = _ptr;
+
+  inTree = true;
+
+  for (auto& dref : inCand.daughterRefVector()) {
+    GenParticlePtr dptr(edm::refToPtr(dref));
+
+    PNode* dnode(_index.find(dptr));
+
+    if (dnode) {
+      // this node is already constructed
+
+      // protect against cyclic graphs - is dnode my ancestor?
+      PNode* p(this);
+      while (p) {
+        if (p == dnode)
+          break;
+        p = p->mother;
+      }
+      if (p) // one of my ancestors is dnode; don't add this node as my daughter
+        continue;
+
+      PNode* dmother(dnode->mother);
+
+      if (dmother) {
+        // and it's someone's daughter
+
+        if (dmother == this) // mine!?
+          continue;
+
+        bool takeCustody(false);
+        if (!isHadronic() && dmother->isHadronic())
+          takeCustody = true;
+        else if (isHadronic() && !dmother->isHadronic())
+          takeCustody = false;
+        else
+          takeCustody = reco::deltaR2(eta, phi, dnode->eta, dnode->phi) < reco::deltaR2(dmother->eta, dmother->phi, dnode->eta, dnode->phi);
+
+        if (takeCustody) {
+          dnode->mother = this;
+          daughters.push_back(dnode);
+          std::vector<PNode*>::iterator dItr(std::find(dmother->daughters.begin(), dmother->daughters.end(), dnode));
+          if (dItr != dmother->daughters.end()) // can happen that this daughter is still being pushed into mother's daughter list
+            dmother->daughters.erase(dItr);
+        }
+      }
+      else {
+        dnode->mother = this;
+        daughters.push_back(dnode);
+      }
+    }
+    else
+      daughters.push_back(_index.make(dptr, this));
+  }
+}
+
+void
+PNodeWithPtr::set(PackedGenParticlePtr const& _ptr, GenNodeIndex& _index)
+{
+  auto& inCand(*_ptr);
+  pdgId = inCand.pdgId();
+  status = 1;
+  mass = inCand.mass();
+  pt = inCand.pt();
+  eta = inCand.eta();
+  phi = inCand.phi();
+
+  PackedGenParticleExposer exposer(inCand);
+  packedPt = exposer.packedPt();
+  packedPhi = exposer.packedPhi();
+  packedM = exposer.packedM();
+
+  miniaodPacked = true;
+
+  candPtr = _ptr;
+  inTree = true;
+
+  auto motherRef(inCand.motherRef());
+  if (motherRef.isNonnull()) {
+    mother = _index.find(reco::CandidatePtr(edm::refToPtr(motherRef)));
+    if (!mother)
+      throw std::out_of_range("GenParticlesFiller: mother of a packed particle is not in the gen particle tree");
+
+    // kick out the existing daughter
+    unsigned iD(0);
+    for (; iD != mother->daughters.size(); ++iD) {
+      auto* d(mother->daughters[iD]);
+
+      double dpt(std::abs(d->pt - pt));
+      if (pt == 0. && dpt > 0.1)
+        continue;
+
+      if (d->pdgId == pdgId && d->status == 1 && reco::deltaR2(d->eta, d->phi, eta, phi) < 0.0001 && dpt / pt < 0.05) {
+        // found a matching candidate, kick it out
+        mother->daughters[iD] = this;
+        replacedCandPtr = static_cast<PNodeWithPtr*>(d)->candPtr;
+
+        if (dynamic_cast<reco::GenParticle const*>(&*replacedCandPtr)) {
+          GenParticlePtr genP(replacedCandPtr);
+          if (replacedCandPtr.isNonnull())
+            statusBits = genP->statusFlags().flags_;
+        }
+
+        static_cast<PNodeWithPtr*>(d)->clear();
+        break;
+      }
+    }
+
+    if (iD == mother->daughters.size()) {
+      // no one was impersonating me
+      mother->daughters.push_back(this);
+    }
+  }
+}
+
 GenParticlesFiller::GenParticlesFiller(std::string const& _name, edm::ParameterSet const& _cfg, edm::ConsumesCollector& _coll) :
   FillerBase(_name, _cfg),
   furtherPrune_(getParameter_<bool>(_cfg, "prune", true))
@@ -267,23 +390,19 @@ GenParticlesFiller::fill(panda::Event& _outEvent, edm::Event const& _inEvent, ed
   if (!finalStateParticlesToken_.second.isUninitialized())
     inFinalStates = &getProduct_(_inEvent, finalStateParticlesToken_);
 
-  std::map<reco::CandidatePtr, PNodeWithPtr*> nodeMap;
-  std::vector<PNodeWithPtr*> rootNodes;
-  std::vector<PNodeWithPtr*> orphans;
-
-  // A global set for tracking which PNodeWithPtr came from packed collection
-  miniaodPacked.clear();
+  GenNodeIndex nodeIndex(nodes_, inParticles, inFinalStates ? inFinalStates->size() : 0, arena_);
+  ArenaVector<PNodeWithPtr*> rootNodes(arena_);
+  ArenaVector<PNodeWithPtr*> orphans(arena_);
 
   for (unsigned iP(0); iP != inParticles.size(); ++iP) {
     auto& inCand(inParticles.at(iP));
     if (inCand.motherRefVector().size() == 0)
-      rootNodes.push_back(new PNodeWithPtr(inParticles.ptrAt(iP), nodeMap));
+      rootNodes.push_back(nodeIndex.make(inParticles.ptrAt(iP)));
   }
   
   if (inFinalStates) {
     for (unsigned iP(0); iP != inFinalStates->size(); ++iP) {
-      auto* finalState(new PNodeWithPtr(inFinalStates->ptrAt(iP), nodeMap));
-      miniaodPacked.insert(finalState);
+      auto* finalState(nodeIndex.make(inFinalStates->ptrAt(iP), iP));
       if (!finalState->mother)
         orphans.push_back(finalState);
     }
@@ -324,12 +443,12 @@ GenParticlesFiller::fill(panda::Event& _outEvent, edm::Event const& _inEvent, ed
       orphan->fillPanda(outUnpacked);
   }
 
-  // ownDaughter is false; need to clean up pnodes
-  for (auto& node : nodeMap)
-    delete node.second;
-
   if (fillUnpacked_)
     outUnpacked.prepareFill(*outputTree_);
 }
 
+GenParticlesFiller::~GenParticlesFiller()
+{
+}
+
 DEFINE_TREEFILLER(GenParticlesFiller);
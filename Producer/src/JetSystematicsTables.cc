@@ -0,0 +1,155 @@
+#include "../interface/JetSystematicsTables.h"
+
+#include "CondFormats/JetMETObjects/interface/JetCorrectorParameters.h"
+#include "CondFormats/JetMETObjects/interface/JetResolutionObject.h"
+
+#include <algorithm>
+
+bool
+JECUncertaintyTable::set(JetCorrectorParameters const& _params)
+{
+  clear();
+
+  auto& definitions(_params.definitions());
+  if (definitions.nBinVar() != 1 || definitions.binVar(0) != "JetEta")
+    return false;
+  if (definitions.nParVar() != 1 || definitions.parVar(0) != "JetPt")
+    return false;
+
+  offsets_.push_back(0);
+
+  for (unsigned iR(0); iR != _params.size(); ++iR) {
+    auto& record(_params.record(iR));
+
+    // binary search below requires ordered, non-overlapping bins
+    if (iR != 0 && record.xMin(0) < etaMax_.back()) {
+      clear();
+      return false;
+    }
+
+    auto& p(record.parameters());
+    if (p.empty() || p.size() % 3 != 0) {
+      clear();
+      return false;
+    }
+
+    etaMin_.push_back(record.xMin(0));
+    etaMax_.push_back(record.xMax(0));
+    for (unsigned iP(0); iP < p.size(); iP += 3) {
+      pt_.push_back(p[iP]);
+      up_.push_back(p[iP + 1]);
+      down_.push_back(p[iP + 2]);
+    }
+    offsets_.push_back(pt_.size());
+  }
+
+  valid_ = true;
+  return true;
+}
+
+void
+JECUncertaintyTable::clear()
+{
+  etaMin_.clear();
+  etaMax_.clear();
+  offsets_.clear();
+  pt_.clear();
+  up_.clear();
+  down_.clear();
+  valid_ = false;
+}
+
+void
+JECUncertaintyTable::get(float _eta, float _pt, float& _up, float& _down) const
+{
+  auto eItr(std::upper_bound(etaMin_.begin(), etaMin_.end(), _eta));
+  if (eItr == etaMin_.begin()) {
+    _up = _down = -999.;
+    return;
+  }
+  unsigned iEta(eItr - etaMin_.begin() - 1);
+  if (_eta >= etaMax_[iEta]) {
+    _up = _down = -999.;
+    return;
+  }
+
+  unsigned first(offsets_[iEta]);
+  unsigned last(offsets_[iEta + 1] - 1);
+
+  if (_pt <= pt_[first]) {
+    _up = up_[first];
+    _down = down_[first];
+    return;
+  }
+  if (_pt >= pt_[last]) {
+    _up = up_[last];
+    _down = down_[last];
+    return;
+  }
+
+  unsigned iP(std::upper_bound(pt_.begin() + first, pt_.begin() + last + 1, _pt) - pt_.begin() - 1);
+
+  // same arithmetic as SimpleJetCorrectionUncertainty::linearInterpolation
+  float x0(pt_[iP]);
+  float x1(pt_[iP + 1]);
+  auto interpolate([_pt, x0, x1](float y0, float y1)->float {
+      if (x0 == x1)
+        return y0;
+      float a((y1 - y0) / (x1 - x0));
+      float b((y0 * x1 - y1 * x0) / (x1 - x0));
+      return a * _pt + b;
+    });
+
+  _up = interpolate(up_[iP], up_[iP + 1]);
+  _down = interpolate(down_[iP], down_[iP + 1]);
+}
+
+bool
+JERScaleFactorTable::set(JME::JetResolutionObject const& _object)
+{
+  clear();
+
+  auto& definition(_object.getDefinition());
+  if (definition.nBins() != 1 || definition.getBins()[0] != JME::Binning::JetEta)
+    return false;
+
+  for (auto& record : _object.getRecords()) {
+    auto& values(record.getParametersValues());
+    if (values.size() < 3) {
+      clear();
+      return false;
+    }
+
+    etaMin_.push_back(record.getBinsRange()[0].min);
+    etaMax_.push_back(record.getBinsRange()[0].max);
+    values_.insert(values_.end(), values.begin(), values.begin() + 3);
+  }
+
+  valid_ = true;
+  return true;
+}
+
+void
+JERScaleFactorTable::clear()
+{
+  etaMin_.clear();
+  etaMax_.clear();
+  values_.clear();
+  valid_ = false;
+}
+
+void
+JERScaleFactorTable::get(float _eta, float& _sf, float& _sfUp, float& _sfDown) const
+{
+  // typically O(10) bins; a scan keeps the first-match semantics at shared edges
+  for (unsigned iB(0); iB != etaMin_.size(); ++iB) {
+    if (_eta >= etaMin_[iB] && _eta <= etaMax_[iB]) {
+      _sf = values_[iB * 3];
+      _sfDown = values_[iB * 3 + 1];
+      _sfUp = values_[iB * 3 + 2];
+      return;
+    }
+  }
+
+  _sf = _sfUp = _sfDown = 1.;
+}
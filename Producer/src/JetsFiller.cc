@@ -16,6 +16,8 @@
 #include "JetMETCorrections/Objects/interface/JetCorrectionsRecord.h"
 #include "JetMETCorrections/Objects/interface/JetCorrector.h"
 #include "JetMETCorrections/Modules/interface/JetResolution.h"
+#include "CondFormats/DataRecord/interface/JetResolutionRcd.h"
+#include "CondFormats/DataRecord/interface/JetResolutionScaleFactorRcd.h"
 
 #include <cmath>
 #include <stdexcept>
@@ -62,6 +64,17 @@ JetsFiller::JetsFiller(std::string const& _name, edm::ParameterSet const& _cfg,
 
   // Check the enums and map
   assert(deepProbs.size() == deepSuff::DEEP_SIZE);
+
+  if (!csvTag_.empty())
+    csvKey_ = btagIndex_.add(csvTag_);
+  if (!cmvaTag_.empty())
+    cmvaKey_ = btagIndex_.add(cmvaTag_);
+  for (auto prob : deepProbs) {
+    if (!deepCsvTag_.empty())
+      deepCsvKeys_.emplace_back(prob.second, btagIndex_.add(deepCsvTag_ + ":prob" + prob.first));
+    if (!deepCmvaTag_.empty())
+      deepCmvaKeys_.emplace_back(prob.second + deepSuff::DEEP_SIZE, btagIndex_.add(deepCmvaTag_ + ":prob" + prob.first));
+  }
 }
 
 JetsFiller::~JetsFiller()
@@ -112,6 +125,19 @@ JetsFiller::branchNames(panda::utils::BranchList& _eventBranches, panda::utils::
     _eventBranches.emplace_back("!" + getName() + ".constituents_");
 }
 
+void
+JetsFiller::declareAccess(FillerAccess& _fillAccess, FillerAccess& _setRefsAccess) const
+{
+  // smearing uses the per-stream random engine shared with other fillers
+  _fillAccess.writes.emplace_back("RandomNumberGenerator");
+
+  _setRefsAccess.reads.emplace_back("pfCandidates");
+  _setRefsAccess.reads.emplace_back("secondaryVertices");
+  _setRefsAccess.reads.emplace_back("vertices");
+  if (!outGenJets_.empty())
+    _setRefsAccess.reads.push_back(outGenJets_);
+}
+
 void
 JetsFiller::fill(panda::Event& _outEvent, edm::Event const& _inEvent, edm::EventSetup const& _setup)
 {
@@ -119,15 +145,10 @@ JetsFiller::fill(panda::Event& _outEvent, edm::Event const& _inEvent, edm::Event
 
   panda::JetCollection& outJets(outputSelector_(_outEvent));
 
-  if (!jecUncertainty_ && !jecName_.empty()) {
-    edm::ESHandle<JetCorrectorParametersCollection> jecColl;
-    _setup.get<JetCorrectionsRecord>().get(jecName_, jecColl);
-    jecUncertainty_ = new JetCorrectionUncertainty((*jecColl)["Uncertainty"]);
-  }
+  if (!jecName_.empty())
+    updateJEC_(_setup);
 
   GenJetView const* genJets(0);
-  JME::JetResolution ptRes;
-  JME::JetResolutionScaleFactor ptResSF;
   double rho(0.);
   CLHEP::RandGauss* random(0);
   
@@ -136,8 +157,7 @@ JetsFiller::fill(panda::Event& _outEvent, edm::Event const& _inEvent, edm::Event
       genJets = &getProduct_(_inEvent, genJetsToken_);
 
     if (!jerName_.empty()) {
-      ptRes = JME::JetResolution::get(_setup, jerName_ + "_pt");
-      ptResSF = JME::JetResolutionScaleFactor::get(_setup, jerName_);
+      updateJER_(_setup);
 
       rho = getProduct_(_inEvent, rhoToken_);
       random = new CLHEP::RandGauss(edm::Service<edm::RandomNumberGenerator>()->getEngine(_inEvent.streamID()));
@@ -146,8 +166,28 @@ JetsFiller::fill(panda::Event& _outEvent, edm::Event const& _inEvent, edm::Event
 
   auto* puidJets(puidJetsToken_.second.isUninitialized() ? nullptr : &getProduct_(_inEvent, puidJetsToken_));
 
-  std::vector<edm::Ptr<reco::Jet>> ptrList;
-  std::vector<edm::Ptr<reco::GenJet>> matchedGenJets;
+  if (genJets) {
+    genJetGrid_.clear();
+    for (auto& genJet : *genJets)
+      genJetGrid_.add(genJet.eta(), genJet.phi());
+    genJetGrid_.build();
+  }
+
+  if (puidJets) {
+    puidJetGrid_.clear();
+    for (auto& puidJet : *puidJets)
+      puidJetGrid_.add(puidJet.eta(), puidJet.phi());
+    puidJetGrid_.build();
+  }
+
+  ArenaVector<edm::Ptr<reco::Jet>> ptrList(arena_);
+  ArenaVector<edm::Ptr<reco::GenJet>> matchedGenJets(arena_);
+
+  bool btagIndexChecked(false);
+
+  // reused across jets to avoid rebuilding the parameter map
+  JME::JetParameters resParams;
+  resParams.setRho(rho);
 
   unsigned iJet(-1);
   for (auto& inJet : inJets) {
@@ -166,14 +206,16 @@ JetsFiller::fill(panda::Event& _outEvent, edm::Event const& _inEvent, edm::Event
     if (dynamic_cast<pat::Jet const*>(&inJet)) {
       auto& patJet(static_cast<pat::Jet const&>(inJet));
 
+      if (!btagIndexChecked) {
+        btagIndex_.update(patJet);
+        btagIndexChecked = true;
+      }
+
       const pat::Jet* puidJet(puidJets == nullptr ? &patJet : nullptr);
       if (puidJet == nullptr) {
-        for (auto& inPuid : *puidJets) {
-          if (reco::deltaR(patJet, inPuid) < 0.2) {
-            puidJet = &inPuid;
-            break;
-          }
-        }
+        int iP(puidJetGrid_.findFirst(patJet.eta(), patJet.phi(), 0.2));
+        if (iP >= 0)
+          puidJet = &puidJets->at(iP);
       }
 
       double nhf(patJet.neutralHadronEnergyFraction());
@@ -211,7 +253,13 @@ JetsFiller::fill(panda::Event& _outEvent, edm::Event const& _inEvent, edm::Event
 
       outJet.rawPt = patJet.pt() * patJet.jecFactor("Uncorrected");
 
-      if (jecUncertainty_) {
+      if (jecTable_.isValid()) {
+        float up, down;
+        jecTable_.get(inJet.eta(), inJet.pt(), up, down);
+        outJet.ptCorrUp = outJet.pt() * (1. + up);
+        outJet.ptCorrDown = outJet.pt() * (1. - down);
+      }
+      else if (jecUncertainty_) {
         jecUncertainty_->setJetEta(inJet.eta());
         jecUncertainty_->setJetPt(inJet.pt());
         outJet.ptCorrUp = outJet.pt() * (1. + jecUncertainty_->getUncertainty(true));
@@ -224,28 +272,28 @@ JetsFiller::fill(panda::Event& _outEvent, edm::Event const& _inEvent, edm::Event
         reco::GenJet const* matchedGenJet(0);
 
         if (genJets) {
-          unsigned iG(0);
-          for (; iG != genJets->size(); ++iG) {
-            auto& genJet(genJets->at(iG));
-            if (reco::deltaR(genJet, inJet) < R_ * 0.5) {
-              matchedGenJet = &genJet;
-              break;
-            }
-          }
-          if (iG != genJets->size())
+          int iG(genJetGrid_.findFirst(inJet.eta(), inJet.phi(), R_ * 0.5));
+          if (iG >= 0) {
+            matchedGenJet = &genJets->at(iG);
             matchedGenJets.emplace_back(genJets->ptrAt(iG));
+          }
           else
             matchedGenJets.emplace_back();
         }
 
         if (!jerName_.empty()) {
-          JME::JetParameters resParams({{JME::Binning::JetPt, inJet.pt()}, {JME::Binning::JetEta, inJet.eta()}, {JME::Binning::Rho, rho}});
-          double res(ptRes.getResolution(resParams) * inJet.pt());
+          resParams.setJetPt(inJet.pt()).setJetEta(inJet.eta());
+          double res(ptRes_.getResolution(resParams) * inJet.pt());
 
-          JME::JetParameters sfParams({{JME::Binning::JetEta, inJet.eta()}});
-          double sf(ptResSF.getScaleFactor(sfParams));
-          double sfUp(ptResSF.getScaleFactor(sfParams, Variation::UP));
-          double sfDown(ptResSF.getScaleFactor(sfParams, Variation::DOWN));
+          float sf, sfUp, sfDown;
+          if (jerSFTable_.isValid())
+            jerSFTable_.get(inJet.eta(), sf, sfUp, sfDown);
+          else {
+            JME::JetParameters sfParams({{JME::Binning::JetEta, inJet.eta()}});
+            sf = ptResSF_.getScaleFactor(sfParams);
+            sfUp = ptResSF_.getScaleFactor(sfParams, Variation::UP);
+            sfDown = ptResSF_.getScaleFactor(sfParams, Variation::DOWN);
+          }
 
           if (matchedGenJet && std::abs(inJet.pt() - matchedGenJet->pt()) < res * 3.) {
             double dpt(inJet.pt() - matchedGenJet->pt());
@@ -264,19 +312,15 @@ JetsFiller::fill(panda::Event& _outEvent, edm::Event const& _inEvent, edm::Event
       }
 
       if (!csvTag_.empty())
-        outJet.csv = patJet.bDiscriminator(csvTag_);
+        outJet.csv = btagIndex_.get(patJet, csvKey_);
       if (!cmvaTag_.empty())
-        outJet.cmva = patJet.bDiscriminator(cmvaTag_);
+        outJet.cmva = btagIndex_.get(patJet, cmvaKey_);
 
       // Fill with -0.5 if we didn't match the jets
-      if (!deepCsvTag_.empty()) {
-        for (auto prob : deepProbs)
-          fillDeepBySwitch_(outJet, prob.second, patJet.bDiscriminator(deepCsvTag_ + ":prob" + prob.first));
-      }
-      if (!deepCmvaTag_.empty()) {
-        for (auto prob : deepProbs)
-          fillDeepBySwitch_(outJet, prob.second + deepSuff::DEEP_SIZE, patJet.bDiscriminator(deepCmvaTag_ + ":prob" + prob.first));
-      }
+      for (auto& key : deepCsvKeys_)
+        fillDeepBySwitch_(outJet, key.first, btagIndex_.get(patJet, key.second));
+      for (auto& key : deepCmvaKeys_)
+        fillDeepBySwitch_(outJet, key.first, btagIndex_.get(patJet, key.second));
 
       if (!qglTag_.empty())
         outJet.qgl = patJet.userFloat(qglTag_);
@@ -477,4 +521,98 @@ JetsFiller::fillDeepBySwitch_(panda::MicroJet& outJet, const unsigned int key, f
   }
 }
 
+void
+JetsFiller::updateJEC_(edm::EventSetup const& _setup)
+{
+  auto& record(_setup.get<JetCorrectionsRecord>());
+  if (record.cacheIdentifier() == jecCacheId_)
+    return;
+
+  jecCacheId_ = record.cacheIdentifier();
+
+  edm::ESHandle<JetCorrectorParametersCollection> jecColl;
+  record.get(jecName_, jecColl);
+  auto& params((*jecColl)["Uncertainty"]);
+
+  delete jecUncertainty_;
+  jecUncertainty_ = 0;
+  if (!jecTable_.set(params))
+    jecUncertainty_ = new JetCorrectionUncertainty(params);
+}
+
+void
+JetsFiller::updateJER_(edm::EventSetup const& _setup)
+{
+  auto& resRecord(_setup.get<JetResolutionRcd>());
+  if (resRecord.cacheIdentifier() != jerCacheId_) {
+    jerCacheId_ = resRecord.cacheIdentifier();
+    ptRes_ = JME::JetResolution::get(_setup, jerName_ + "_pt");
+  }
+
+  auto& sfRecord(_setup.get<JetResolutionScaleFactorRcd>());
+  if (sfRecord.cacheIdentifier() != jerSFCacheId_) {
+    jerSFCacheId_ = sfRecord.cacheIdentifier();
+
+    edm::ESHandle<JME::JetResolutionObject> sfObject;
+    sfRecord.get(jerName_, sfObject);
+    ptResSF_ = JME::JetResolutionScaleFactor(*sfObject);
+    jerSFTable_.set(*sfObject);
+  }
+}
+
+unsigned
+BTagDiscriminatorIndex::add(std::string const& _name)
+{
+  // same alias as pat::Jet::bDiscriminator
+  if (_name.empty() || _name == "default")
+    names_.push_back("trackCountingHighEffBJetTags");
+  else
+    names_.push_back(_name);
+  positions_.push_back(-1);
+  resolved_ = false;
+  return names_.size() - 1;
+}
+
+void
+BTagDiscriminatorIndex::update(pat::Jet const& _jet)
+{
+  auto& pairs(_jet.getPairDiscri());
+
+  if (resolved_ && pairs.size() == layoutSize_) {
+    unsigned iN(0);
+    for (; iN != names_.size(); ++iN) {
+      int pos(positions_[iN]);
+      if (pos >= 0 && pairs[pos].first != names_[iN])
+        break;
+    }
+    if (iN == names_.size())
+      return;
+  }
+
+  layoutSize_ = pairs.size();
+  for (unsigned iN(0); iN != names_.size(); ++iN) {
+    positions_[iN] = -1;
+    // the last match, as in pat::Jet::bDiscriminator
+    for (unsigned iP(0); iP != pairs.size(); ++iP) {
+      if (pairs[iP].first == names_[iN])
+        positions_[iN] = iP;
+    }
+  }
+  resolved_ = true;
+}
+
+float
+BTagDiscriminatorIndex::get(pat::Jet const& _jet, unsigned _key) const
+{
+  auto& pairs(_jet.getPairDiscri());
+  if (!resolved_ || pairs.size() != layoutSize_)
+    return _jet.bDiscriminator(names_[_key]);
+
+  int pos(positions_[_key]);
+  if (pos < 0)
+    return -1000.; // same as pat::Jet::bDiscriminator for a missing name
+
+  return pairs[pos].second;
+}
+
 DEFINE_TREEFILLER(JetsFiller);
@@ -0,0 +1,13 @@
+#include "../interface/LazyEventIndex.h"
+
+void
+LazyEventIndex::ensureBuilt_(edm::Event const& _event)
+{
+  if (!built_.load(std::memory_order_acquire)) {
+    std::lock_guard<std::mutex> lock(buildMutex_);
+    if (!built_.load(std::memory_order_relaxed)) {
+      build_(_event);
+      built_.store(true, std::memory_order_release);
+    }
+  }
+}
@@ -57,7 +57,8 @@ MetExtraFiller::fill(panda::Event& _outEvent, edm::Event const& _inEvent, edm::E
   auto* patMets(getProductSafe_(_inEvent, patMetToken_));
   auto* noHFMets(getProductSafe_(_inEvent, noHFMetToken_));
   auto* genMets(getProductSafe_(_inEvent, genMetToken_));
-  auto* candidates(getProductSafe_(_inEvent, candidatesToken_));
+  // only an existence check; the candidates are read through the shared PF candidate index (same product)
+  bool hasCandidates(getProductSafe_(_inEvent, candidatesToken_) != 0);
 
   double noMuMex(0.);
   double noMuMey(0.);
@@ -97,7 +98,7 @@ MetExtraFiller::fill(panda::Event& _outEvent, edm::Event const& _inEvent, edm::E
     _outEvent.noHFMet.phi = noHFMet.phi();
   }
 
-  if (candidates) {
+  if (hasCandidates) {
     double trkMex(0.);
     double trkMey(0.);
     double neutralMex(0.);
@@ -107,27 +108,33 @@ MetExtraFiller::fill(panda::Event& _outEvent, edm::Event const& _inEvent, edm::E
     double hfMex(0.);
     double hfMey(0.);
 
-    for (auto& cand : *candidates) {
-      if (std::abs(cand.pdgId()) == 13) {
-        noMuMex += cand.px();
-        noMuMey += cand.py();
+    auto& pfIndex(getPFCandidateIndex_(_inEvent));
+
+    for (unsigned iC(0); iC != pfIndex.size(); ++iC) {
+      int pdgId(pfIndex.pdgId(iC));
+      double px(pfIndex.px(iC));
+      double py(pfIndex.py(iC));
+
+      if (std::abs(pdgId) == 13) {
+        noMuMex += px;
+        noMuMey += py;
       }
-      else if (cand.pdgId() == 130) {
-        neutralMex -= cand.px();
-        neutralMey -= cand.py();
+      else if (pdgId == 130) {
+        neutralMex -= px;
+        neutralMey -= py;
       }
-      else if (cand.pdgId() == 22) {
-        photonMex -= cand.px();
-        photonMey -= cand.py();
+      else if (pdgId == 22) {
+        photonMex -= px;
+        photonMey -= py;
       }
-      else if (cand.pdgId() == 1 || cand.pdgId() == 2) {
-        hfMex -= cand.px();
-        hfMey -= cand.py();
+      else if (pdgId == 1 || pdgId == 2) {
+        hfMex -= px;
+        hfMey -= py;
       }
 
-      if (cand.charge() != 0) {
-        trkMex -= cand.px();
-        trkMey -= cand.py();
+      if (pfIndex.charge(iC) != 0) {
+        trkMex -= px;
+        trkMey -= py;
       }
     }
 
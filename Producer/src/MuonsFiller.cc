@@ -30,6 +30,17 @@ MuonsFiller::branchNames(panda::utils::BranchList& _eventBranches, panda::utils:
     _eventBranches.emplace_back("!muons.matchedGen_");
 }
 
+void
+MuonsFiller::declareAccess(FillerAccess& _fillAccess, FillerAccess& _setRefsAccess) const
+{
+  // smearing uses the per-stream random engine shared with other fillers
+  _fillAccess.writes.emplace_back("RandomNumberGenerator");
+
+  _setRefsAccess.reads.emplace_back("pfCandidates");
+  _setRefsAccess.reads.emplace_back("vertices");
+  _setRefsAccess.reads.emplace_back("genParticles");
+}
+
 void
 MuonsFiller::fill(panda::Event& _outEvent, edm::Event const& _inEvent, edm::EventSetup const& _setup)
 {
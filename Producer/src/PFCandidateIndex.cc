@@ -0,0 +1,43 @@
+#include "../interface/PFCandidateIndex.h"
+
+#include "DataFormats/PatCandidates/interface/PackedCandidate.h"
+
+void
+PFCandidateIndex::build_(edm::Event const& _event)
+{
+  candidates_ = &getProduct_(_event, token_, "fillers.common.pfCandidates");
+
+  unsigned nC(candidates_->size());
+
+  pt_.resize(nC);
+  eta_.resize(nC);
+  phi_.resize(nC);
+  px_.resize(nC);
+  py_.resize(nC);
+  pdgId_.resize(nC);
+  charge_.resize(nC);
+  vertexKey_.resize(nC);
+
+  grid_.clear();
+
+  for (unsigned iC(0); iC != nC; ++iC) {
+    auto& cand(candidates_->at(iC));
+
+    pt_[iC] = cand.pt();
+    eta_[iC] = cand.eta();
+    phi_[iC] = cand.phi();
+    px_[iC] = cand.px();
+    py_[iC] = cand.py();
+    pdgId_[iC] = cand.pdgId();
+    charge_[iC] = cand.charge();
+
+    vertexKey_[iC] = -1;
+    auto* packed(dynamic_cast<pat::PackedCandidate const*>(&cand));
+    if (packed && packed->vertexRef().isNonnull())
+      vertexKey_[iC] = packed->vertexRef().key();
+
+    grid_.add(eta_[iC], phi_[iC]);
+  }
+
+  grid_.build();
+}
@@ -25,6 +25,13 @@ PFCandsFiller::branchNames(panda::utils::BranchList& _eventBranches, panda::util
   _eventBranches.emplace_back("tracks");
 }
 
+void
+PFCandsFiller::declareAccess(FillerAccess&, FillerAccess& _setRefsAccess) const
+{
+  // pfRangeMax of the vertices is set in setRefs
+  _setRefsAccess.writes.emplace_back("vertices");
+}
+
 void
 PFCandsFiller::fill(panda::Event& _outEvent, edm::Event const& _inEvent, edm::EventSetup const&)
 {
@@ -40,68 +47,30 @@ PFCandsFiller::fill(panda::Event& _outEvent, edm::Event const& _inEvent, edm::Ev
   //   edm::Ref<View>(viewHandle, iview) maps to a puppi candidate via puppiMap
   //   View::refAt(iview).key() is the index of the PF candidate in the original collection
 
-  std::map<reco::CandidatePtr, reco::Candidate const*> inCandsMap;
+  ArenaVector<reco::CandidatePtr> ptrList(arena_);
+  ptrList.reserve(inCands.size());
+  for (unsigned iC(0); iC != inCands.size(); ++iC)
+    ptrList.push_back(inCands.ptrAt(iC)); // returns a pointer to the original collection (as opposed to Ref<CandidateView> ref(candsHandle, iC));
 
-  std::map<reco::Candidate const*, reco::CandidatePtr> puppiPtrMap;
+  // puppi candidates aligned with inCands; empty if the corresponding map is not configured
+  ArenaVector<reco::CandidatePtr> puppiPtrs(arena_);
+  ArenaVector<reco::CandidatePtr> puppiNoLepPtrs(arena_);
 
-  if (!puppiMapToken_.second.isUninitialized()) {
-    for (unsigned iC(0); iC != inCands.size(); ++iC) {
-      auto ptrToPF(inCands.ptrAt(iC)); // returns a pointer to the original collection (as opposed to Ref<CandidateView> ref(candsHandle, iC));
-      inCandsMap[ptrToPF] = &inCands.at(iC);
-    }
+  if (!puppiMapToken_.second.isUninitialized() || !puppiNoLepMapToken_.second.isUninitialized())
+    indexCandidates_(ptrList);
 
-    auto& puppiMap(getProduct_(_inEvent, puppiMapToken_));
-    edm::Handle<reco::CandidateView> puppiInputHandle;
-    auto& puppiInput(getProduct_(_inEvent, puppiInputToken_, &puppiInputHandle));
-    for (unsigned iC(0); iC != puppiInput.size(); ++iC) {
-      edm::Ref<reco::CandidateView> inputRef(puppiInputHandle, iC);
-      auto& puppiPtr(puppiMap[inputRef]);
-
-      auto ptrToPF(puppiInput.ptrAt(iC));
-      auto inCandsItr(inCandsMap.find(ptrToPF));
-      if (inCandsItr == inCandsMap.end()) {
-        // You are here because of a misconfiguration or because the input to puppi had some layer(s) of PF candidate cloning.
-        // It may be possible to trace back to the original PF collection through calls to sourceCandidatePtr()
-        // but for now we don't need to implement it.
-        throw std::runtime_error("Cannot find candidate matching a puppi input");
-      }
-
-      puppiPtrMap[inCandsItr->second] = puppiPtr;
-    }
+  if (!puppiMapToken_.second.isUninitialized()) {
+    puppiPtrs.resize(inCands.size());
+    mapPuppi_(_inEvent, puppiMapToken_, puppiInputToken_, puppiPtrs, "puppi");
   }
 
-  std::map<reco::Candidate const*, reco::CandidatePtr> puppiNoLepPtrMap;
-
   if (!puppiNoLepMapToken_.second.isUninitialized()) {
-    if (inCandsMap.empty()) {
-      for (unsigned iC(0); iC != inCands.size(); ++iC) {
-        auto ptrToPF(inCands.ptrAt(iC)); // returns a pointer to the original collection (as opposed to Ref<CandidateView> ref(candsHandle, iC));
-        inCandsMap[ptrToPF] = &inCands.at(iC);
-      }
-    }
-
-    auto& puppiNoLepMap(getProduct_(_inEvent, puppiNoLepMapToken_));
-    edm::Handle<reco::CandidateView> puppiNoLepInputHandle;
-    auto& puppiNoLepInput(getProduct_(_inEvent, puppiNoLepInputToken_, &puppiNoLepInputHandle));
-    for (unsigned iC(0); iC != puppiNoLepInput.size(); ++iC) {
-      edm::Ref<reco::CandidateView> inputRef(puppiNoLepInputHandle, iC);
-      auto& puppiNoLepPtr(puppiNoLepMap[inputRef]);
-
-      auto ptrToPF(puppiNoLepInput.ptrAt(iC));
-      auto inCandsItr(inCandsMap.find(ptrToPF));
-      if (inCandsItr == inCandsMap.end()) {
-        // See above
-        throw std::runtime_error("Cannot find candidate matching a puppiNoLep input");
-      }
-
-      puppiNoLepPtrMap[inCandsItr->second] = puppiNoLepPtr;
-    }
+    puppiNoLepPtrs.resize(inCands.size());
+    mapPuppi_(_inEvent, puppiNoLepMapToken_, puppiNoLepInputToken_, puppiNoLepPtrs, "puppiNoLep");
   }
 
   auto& outCands(_outEvent.pfCandidates);
 
-  std::vector<reco::CandidatePtr> ptrList;
-
   unsigned iP(-1);
   for (auto& inCand : inCands) {
     ++iP;
@@ -138,17 +107,11 @@ PFCandsFiller::fill(panda::Event& _outEvent, edm::Event const& _inEvent, edm::Ev
       double puppiW(-1.);
       double puppiWNoLep(-1.);
 
-      if (!puppiPtrMap.empty()) {
-        auto&& ppItr(puppiPtrMap.find(&inCand));
-        if (ppItr != puppiPtrMap.end() && ppItr->second.isNonnull())
-          puppiW = ppItr->second->pt() / inCand.pt();
-      }
+      if (!puppiPtrs.empty() && puppiPtrs[iP].isNonnull())
+        puppiW = puppiPtrs[iP]->pt() / inCand.pt();
 
-      if (!puppiNoLepPtrMap.empty()) {
-        auto&& ppItr(puppiNoLepPtrMap.find(&inCand));
-        if (ppItr != puppiNoLepPtrMap.end() && ppItr->second.isNonnull())
-          puppiWNoLep = ppItr->second->pt() / inCand.pt();
-      }
+      if (!puppiNoLepPtrs.empty() && puppiNoLepPtrs[iP].isNonnull())
+        puppiWNoLep = puppiNoLepPtrs[iP]->pt() / inCand.pt();
 
       outCand.setPuppiW(puppiW, puppiWNoLep);
     }
@@ -164,8 +127,6 @@ PFCandsFiller::fill(panda::Event& _outEvent, edm::Event const& _inEvent, edm::Ev
     }
 
     outCand.hCalFrac = inPacked->hcalFraction();
-
-    ptrList.push_back(inCands.ptrAt(iP));
   }
 
   auto ByVertexAndPt([](panda::Element const& e1, panda::Element const& e2)->Bool_t {
@@ -190,9 +151,8 @@ PFCandsFiller::fill(panda::Event& _outEvent, edm::Event const& _inEvent, edm::Ev
     auto& ptr(ptrList[idx]);
     objectMap.add(ptr, outCand);
 
-    auto&& ppItr(puppiPtrMap.find(ptr.get()));
-    if (ppItr != puppiPtrMap.end() && ppItr->second.isNonnull())
-      puppiMap.add(ppItr->second, outCand);
+    if (!puppiPtrs.empty() && puppiPtrs[idx].isNonnull())
+      puppiMap.add(puppiPtrs[idx], outCand);
 
     // add track information for charged hadrons
     // track order matters; track ref from PFCand are set during Event::getEntry relying on the order
@@ -230,6 +190,78 @@ PFCandsFiller::fill(panda::Event& _outEvent, edm::Event const& _inEvent, edm::Ev
     orderedVertices_[iV] = inVertices.ptrAt(iV);
 }
 
+void
+PFCandsFiller::indexCandidates_(ArenaVector<reco::CandidatePtr> const& _ptrs)
+{
+  pfProductID_ = _ptrs.empty() ? edm::ProductID() : _ptrs.front().id();
+  singleProduct_ = true;
+  unsigned maxKey(0);
+  for (auto& ptr : _ptrs) {
+    if (ptr.id() != pfProductID_)
+      singleProduct_ = false;
+    if (ptr.key() > maxKey)
+      maxKey = ptr.key();
+  }
+
+  if (singleProduct_) {
+    // the usual case (packedPFCandidates): the key is the index in the product
+    keyToIndex_.assign(maxKey + 1, -1);
+    for (unsigned iC(0); iC != _ptrs.size(); ++iC)
+      keyToIndex_[_ptrs[iC].key()] = iC;
+  }
+  else {
+    ptrToIndex_.clear();
+    for (unsigned iC(0); iC != _ptrs.size(); ++iC)
+      ptrToIndex_[ptrHash_(_ptrs[iC])] = iC;
+  }
+}
+
+int
+PFCandsFiller::findCandidate_(reco::CandidatePtr const& _ptr) const
+{
+  if (singleProduct_) {
+    if (_ptr.id() != pfProductID_ || _ptr.key() >= keyToIndex_.size())
+      return -1;
+    return keyToIndex_[_ptr.key()];
+  }
+  else {
+    auto itr(ptrToIndex_.find(ptrHash_(_ptr)));
+    if (itr == ptrToIndex_.end())
+      return -1;
+    return itr->second;
+  }
+}
+
+void
+PFCandsFiller::mapPuppi_(edm::Event const& _inEvent, NamedToken<CandidatePtrMap> const& _mapToken, NamedToken<reco::CandidateView> const& _inputToken, ArenaVector<reco::CandidatePtr>& _puppiPtrs, char const* _name)
+{
+  auto& puppiMap(getProduct_(_inEvent, _mapToken));
+  edm::Handle<reco::CandidateView> puppiInputHandle;
+  auto& puppiInput(getProduct_(_inEvent, _inputToken, &puppiInputHandle));
+
+  for (unsigned iC(0); iC != puppiInput.size(); ++iC) {
+    edm::Ref<reco::CandidateView> inputRef(puppiInputHandle, iC);
+
+    int idx(findCandidate_(puppiInput.ptrAt(iC)));
+    if (idx < 0) {
+      // You are here because of a misconfiguration or because the input to puppi had some layer(s) of PF candidate cloning.
+      // It may be possible to trace back to the original PF collection through calls to sourceCandidatePtr()
+      // but for now we don't need to implement it.
+      throw std::runtime_error(std::string("Cannot find candidate matching a ") + _name + " input");
+    }
+
+    _puppiPtrs[idx] = puppiMap[inputRef];
+  }
+}
+
+/*static*/
+unsigned long long
+PFCandsFiller::ptrHash_(reco::CandidatePtr const& _ptr)
+{
+  auto& id(_ptr.id());
+  return (static_cast<unsigned long long>(id.processIndex()) << 48) | (static_cast<unsigned long long>(id.productIndex()) << 32) | _ptr.key();
+}
+
 void
 PFCandsFiller::setRefs(ObjectMapStore const& _objectMaps)
 {
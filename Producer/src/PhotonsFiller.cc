@@ -8,7 +8,6 @@
 #include "DataFormats/EgammaCandidates/interface/GsfElectron.h"
 #include "DataFormats/PatCandidates/interface/Photon.h"
 #include "DataFormats/Common/interface/RefToPtr.h"
-#include "DataFormats/Math/interface/deltaR.h"
 
 #include <cmath>
 
@@ -21,7 +20,6 @@ PhotonsFiller::PhotonsFiller(std::string const& _name, edm::ParameterSet const&
   getToken_(photonsToken_, _cfg, _coll, "photons");
   getToken_(smearedPhotonsToken_, _cfg, _coll, "smearedPhotons", false);
   getToken_(regressionPhotonsToken_, _cfg, _coll, "regressionPhotons", false);
-  getToken_(pfCandidatesToken_, _cfg, _coll, "common", "pfCandidates");
   getToken_(ebHitsToken_, _cfg, _coll, "common", "ebHits");
   getToken_(eeHitsToken_, _cfg, _coll, "common", "eeHits");
   getToken_(looseIdToken_, _cfg, _coll, "looseId");
@@ -50,13 +48,21 @@ PhotonsFiller::branchNames(panda::utils::BranchList& _eventBranches, panda::util
     _eventBranches += {"!photons.matchedGen_"};
 }
 
+void
+PhotonsFiller::declareAccess(FillerAccess&, FillerAccess& _setRefsAccess) const
+{
+  _setRefsAccess.reads.emplace_back("superClusters");
+  _setRefsAccess.reads.emplace_back("pfCandidates");
+  _setRefsAccess.reads.emplace_back("genParticles");
+}
+
 void
 PhotonsFiller::fill(panda::Event& _outEvent, edm::Event const& _inEvent, edm::EventSetup const& _setup)
 {
   auto& inPhotons(getProduct_(_inEvent, photonsToken_));
   auto* inSmearedPhotons(getProductSafe_(_inEvent, smearedPhotonsToken_));
   auto* inRegressionPhotons(getProductSafe_(_inEvent, regressionPhotonsToken_));
-  auto& pfCandidates(getProduct_(_inEvent, pfCandidatesToken_));
+  auto& pfIndex(getPFCandidateIndex_(_inEvent));
   auto& ebHits(getProduct_(_inEvent, ebHitsToken_));
   auto& eeHits(getProduct_(_inEvent, eeHitsToken_));
   auto& looseId(getProduct_(_inEvent, looseIdToken_));
@@ -82,32 +88,31 @@ PhotonsFiller::fill(panda::Event& _outEvent, edm::Event const& _inEvent, edm::Ev
       return &*hitItr;
     });
 
-  auto findPF([&pfCandidates](reco::Photon const& inPhoton)->reco::CandidatePtr {
-      int iMatch(-1);
-
-      double minDR(0.1);
-      for (unsigned iPF(0); iPF != pfCandidates.size(); ++iPF) {
-        auto& pf(pfCandidates.at(iPF));
-        if (std::abs(pf.pdgId()) != 11 || pf.pdgId() == 22)
-          continue;
+  // Match all photons once; the results are indexed by input photon and carried through the sort below
+  ArenaVector<reco::CandidatePtr> matchedPFs(arena_);
+  matchedPFs.reserve(inPhotons.size());
+  for (auto& inPhoton : inPhotons) {
+    int iMatch(pfIndex.grid().findClosest(inPhoton.eta(), inPhoton.phi(), 0.1, [&pfIndex](unsigned iPF) {
+          return std::abs(pfIndex.pdgId(iPF)) == 11;
+        }));
 
-        double dR(reco::deltaR(pf, inPhoton));
-        if (dR < minDR) {
-          minDR = dR;
-          iMatch = iPF;
-        }
-      }
+    if (iMatch >= 0)
+      matchedPFs.push_back(pfIndex.ptrAt(iMatch));
+    else
+      matchedPFs.emplace_back();
+  }
 
-      if (iMatch >= 0)
-        return pfCandidates.ptrAt(iMatch);
-      else
-        return reco::CandidatePtr();
-    });
+  // pt of the first smeared / regression photon with the same supercluster
+  ArenaMap<reco::SuperClusterRef, double> smearedPts(arena_);
+  if (inSmearedPhotons) {
+    for (auto& smeared : *inSmearedPhotons)
+      smearedPts.emplace(smeared.superCluster(), smeared.pt());
+  }
 
-  std::vector<reco::Candidate const*> chargedPFCandidates;
-  for (auto& cand : pfCandidates) {
-    if (cand.charge() != 0)
-      chargedPFCandidates.emplace_back(&cand);
+  ArenaMap<reco::SuperClusterRef, double> regressionPts(arena_);
+  if (inRegressionPhotons) {
+    for (auto& reg : *inRegressionPhotons)
+      regressionPts.emplace(reg.superCluster(), reg.pt());
   }
 
   noZS::EcalClusterLazyTools lazyTools(_inEvent, _setup, ebHitsToken_.second, eeHitsToken_.second);
@@ -188,15 +193,10 @@ PhotonsFiller::fill(panda::Event& _outEvent, edm::Event const& _inEvent, edm::Ev
       outPhoton.csafeVeto = static_cast<pat::Photon const&>(inPhoton).passElectronVeto();
 
     outPhoton.pfchVeto = true;
-    for (auto* cand : chargedPFCandidates) {
-      if (reco::deltaR(*cand, inPhoton) > 0.1)
-        continue;
-
-      if (cand->pt() / scRawPt > 0.6) {
-        outPhoton.pfchVeto = false;
-        break;
-      }
-    }
+    pfIndex.grid().forEachNearUnordered(inPhoton.eta(), inPhoton.phi(), 0.1, [&pfIndex, &outPhoton, scRawPt](unsigned iPF, double) {
+        if (pfIndex.charge(iPF) != 0 && pfIndex.pt(iPF) / scRawPt > 0.6)
+          outPhoton.pfchVeto = false;
+      });
 
     outPhoton.mipEnergy = inPhoton.mipTotEnergy();
 
@@ -249,28 +249,17 @@ PhotonsFiller::fill(panda::Event& _outEvent, edm::Event const& _inEvent, edm::Ev
         outPhoton.timeSpan = dt;
     }
 
-    reco::CandidatePtr matchedPF(findPF(inPhoton));
-
+    auto& matchedPF(matchedPFs[iPh]);
     if (matchedPF.isNonnull())
       outPhoton.pfPt = matchedPF->pt();
 
-    if (inSmearedPhotons) {
-      for (auto& smeared : *inSmearedPhotons) {
-        if (smeared.superCluster() == scRef) {
-          outPhoton.smearedPt = smeared.pt();
-          break;
-        }
-      }
-    }
+    auto&& smearedItr(smearedPts.find(scRef));
+    if (smearedItr != smearedPts.end())
+      outPhoton.smearedPt = smearedItr->second;
 
-    if (inRegressionPhotons) {
-      for (auto& reg : *inRegressionPhotons) {
-        if (reg.superCluster() == scRef) {
-          outPhoton.regPt = reg.pt();
-          break;
-        }
-      }
-    }
+    auto&& regItr(regressionPts.find(scRef));
+    if (regItr != regressionPts.end())
+      outPhoton.regPt = regItr->second;
 
     ptrList.push_back(inPhotons.ptrAt(iPh));
   }
@@ -289,7 +278,7 @@ PhotonsFiller::fill(panda::Event& _outEvent, edm::Event const& _inEvent, edm::Ev
     phoPhoMap.add(ptrList[idx], outPhoton);
     scPhoMap.add(edm::refToPtr(ptrList[idx]->superCluster()), outPhoton);
 
-    reco::CandidatePtr matchedPF(findPF(*ptrList[idx]));
+    auto& matchedPF(matchedPFs[idx]);
     if (matchedPF.isNonnull())
       pfPhoMap.add(matchedPF, outPhoton);
 
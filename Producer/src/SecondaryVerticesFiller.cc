@@ -19,6 +19,13 @@ SecondaryVerticesFiller::branchNames(panda::utils::BranchList& _eventBranches, p
   _eventBranches.emplace_back(getName());
 }
 
+void
+SecondaryVerticesFiller::declareAccess(FillerAccess&, FillerAccess& _setRefsAccess) const
+{
+  _setRefsAccess.reads.emplace_back("pfCandidates");
+  _setRefsAccess.reads.emplace_back("vertices");
+}
+
 void
 SecondaryVerticesFiller::fill(panda::Event& _outEvent, edm::Event const& _inEvent, edm::EventSetup const& _setup)
 {
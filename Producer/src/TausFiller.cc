@@ -22,6 +22,13 @@ TausFiller::branchNames(panda::utils::BranchList& _eventBranches, panda::utils::
     _eventBranches.emplace_back("!taus.matchedGen_");
 }
 
+void
+TausFiller::declareAccess(FillerAccess&, FillerAccess& _setRefsAccess) const
+{
+  _setRefsAccess.reads.emplace_back("vertices");
+  _setRefsAccess.reads.emplace_back("genParticles");
+}
+
 void
 TausFiller::fill(panda::Event& _outEvent, edm::Event const& _inEvent, edm::EventSetup const& _setup)
 {
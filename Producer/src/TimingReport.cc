@@ -0,0 +1,177 @@
+#include "../interface/TimingReport.h"
+
+#include "FWCore/Utilities/interface/Exception.h"
+
+#include "TH1D.h"
+#include "TTree.h"
+
+#include <cmath>
+#include <algorithm>
+#include <iomanip>
+
+double constexpr TimingReport::minMS;
+double constexpr TimingReport::maxMS;
+
+unsigned
+TimingReport::addStep(std::string const& _name, std::string const& _phase)
+{
+  steps_.emplace_back();
+  auto& step(steps_.back());
+  step.name = _name;
+  step.phase = _phase;
+  step.counts.assign(nBins, 0);
+
+  return steps_.size() - 1;
+}
+
+void
+TimingReport::fill(unsigned _step, double _ms, EventId const& _id)
+{
+  auto& step(steps_[_step]);
+
+  int bin(0);
+  if (_ms > minMS)
+    bin = std::min(int(nBins) - 1, int(nBins * std::log(_ms / minMS) / std::log(maxMS / minMS)));
+
+  ++step.counts[bin];
+  ++step.n;
+  step.sum += _ms;
+  if (_ms > step.max) {
+    step.max = _ms;
+    step.maxEvent = _id;
+  }
+}
+
+void
+TimingReport::merge(TimingReport const& _other)
+{
+  if (_other.steps_.size() != steps_.size())
+    throw cms::Exception("TimingReport") << "Cannot merge reports with different steps";
+
+  for (unsigned iS(0); iS != steps_.size(); ++iS) {
+    auto& step(steps_[iS]);
+    auto& other(_other.steps_[iS]);
+
+    for (unsigned iB(0); iB != nBins; ++iB)
+      step.counts[iB] += other.counts[iB];
+
+    step.n += other.n;
+    step.sum += other.sum;
+    if (other.max > step.max) {
+      step.max = other.max;
+      step.maxEvent = other.maxEvent;
+    }
+  }
+}
+
+double
+TimingReport::quantile(unsigned _step, double _q) const
+{
+  auto& step(steps_[_step]);
+  if (step.n == 0)
+    return 0.;
+
+  double target(_q * step.n);
+  unsigned long long cumulative(0);
+  for (unsigned iB(0); iB != nBins; ++iB) {
+    if (cumulative + step.counts[iB] >= target) {
+      // log-linear interpolation within the bin
+      double frac((target - cumulative) / step.counts[iB]);
+      double low(binLowEdge_(iB));
+      double high(binLowEdge_(iB + 1));
+      return std::min(step.max, low * std::pow(high / low, frac));
+    }
+    cumulative += step.counts[iB];
+  }
+
+  return step.max;
+}
+
+void
+TimingReport::write(TDirectory& _dir) const
+{
+  TDirectory::TContext context(&_dir);
+
+  auto* timingDir(_dir.mkdir("timing"));
+  timingDir->cd();
+
+  std::vector<double> edges(nBins + 1);
+  for (unsigned iB(0); iB <= nBins; ++iB)
+    edges[iB] = binLowEdge_(iB);
+
+  for (auto& step : steps_) {
+    std::string hname(step.name + "_" + step.phase);
+    TH1D hist(hname.c_str(), (step.name + "::" + step.phase + ";latency (ms);events").c_str(), nBins, edges.data());
+    for (unsigned iB(0); iB != nBins; ++iB)
+      hist.SetBinContent(iB + 1, step.counts[iB]);
+    hist.SetEntries(step.n);
+    hist.Write();
+  }
+
+  _dir.cd();
+
+  std::string name;
+  std::string phase;
+  unsigned long long n;
+  double mean, p50, p90, p99, max;
+  EventId maxEvent;
+
+  TTree summary("timingSummary", "Latency percentiles (ms)");
+  summary.Branch("name", &name);
+  summary.Branch("phase", &phase);
+  summary.Branch("n", &n, "n/l");
+  summary.Branch("mean", &mean, "mean/D");
+  summary.Branch("p50", &p50, "p50/D");
+  summary.Branch("p90", &p90, "p90/D");
+  summary.Branch("p99", &p99, "p99/D");
+  summary.Branch("max", &max, "max/D");
+  summary.Branch("maxRun", &maxEvent.run, "maxRun/i");
+  summary.Branch("maxLumi", &maxEvent.lumi, "maxLumi/i");
+  summary.Branch("maxEvent", &maxEvent.event, "maxEvent/l");
+
+  for (unsigned iS(0); iS != steps_.size(); ++iS) {
+    auto& step(steps_[iS]);
+    name = step.name;
+    phase = step.phase;
+    n = step.n;
+    mean = step.n == 0 ? 0. : step.sum / step.n;
+    p50 = quantile(iS, 0.5);
+    p90 = quantile(iS, 0.9);
+    p99 = quantile(iS, 0.99);
+    max = step.max;
+    maxEvent = step.maxEvent;
+    summary.Fill();
+  }
+
+  summary.Write();
+}
+
+void
+TimingReport::writeJSON(std::ostream& _out) const
+{
+  _out << "[" << std::endl;
+
+  for (unsigned iS(0); iS != steps_.size(); ++iS) {
+    auto& step(steps_[iS]);
+    _out << std::setprecision(6)
+         << "  {\"name\": \"" << step.name << "\", \"phase\": \"" << step.phase << "\", \"n\": " << step.n
+         << ", \"mean\": " << (step.n == 0 ? 0. : step.sum / step.n)
+         << ", \"p50\": " << quantile(iS, 0.5)
+         << ", \"p90\": " << quantile(iS, 0.9)
+         << ", \"p99\": " << quantile(iS, 0.99)
+         << ", \"max\": " << step.max
+         << ", \"maxEvent\": [" << step.maxEvent.run << ", " << step.maxEvent.lumi << ", " << step.maxEvent.event << "]}";
+    if (iS != steps_.size() - 1)
+      _out << ",";
+    _out << std::endl;
+  }
+
+  _out << "]" << std::endl;
+}
+
+/*static*/
+double
+TimingReport::binLowEdge_(unsigned _iB)
+{
+  return minMS * std::pow(maxMS / minMS, double(_iB) / nBins);
+}
@@ -0,0 +1,88 @@
+#include "../interface/TraceRecorder.h"
+
+#include <atomic>
+#include <set>
+#include <iomanip>
+
+void
+TraceRecorder::record(std::string const& _name, char const* _category, Clock::time_point _begin, Clock::time_point _end,
+                      unsigned _run/* = 0*/, unsigned _lumi/* = 0*/, unsigned long long _event/* = 0*/)
+{
+  unsigned tid(threadIndex());
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  records_.push_back({_name, _category, _begin, _end - _begin, pid_, tid, _run, _lumi, _event});
+}
+
+void
+TraceRecorder::absorb(TraceRecorder& _other)
+{
+  std::lock_guard<std::mutex> lockOther(_other.mutex_);
+  std::lock_guard<std::mutex> lock(mutex_);
+
+  records_.insert(records_.end(), _other.records_.begin(), _other.records_.end());
+  _other.records_.clear();
+}
+
+void
+TraceRecorder::writeJSON(std::ostream& _out) const
+{
+  Clock::time_point origin(Clock::time_point::max());
+  std::set<unsigned> pids;
+  for (auto& rec : records_) {
+    if (rec.begin < origin)
+      origin = rec.begin;
+    pids.insert(rec.pid);
+  }
+
+  auto toUS([](Clock::duration const& d)->double {
+      return std::chrono::duration_cast<std::chrono::nanoseconds>(d).count() * 1.e-3;
+    });
+
+  _out << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [" << std::endl;
+
+  // process names
+  for (unsigned pid : pids) {
+    _out << "{\"name\": \"process_name\", \"ph\": \"M\", \"pid\": " << pid << ", \"args\": {\"name\": \"";
+    if (pid == 0)
+      _out << "PandaProducer (global)";
+    else
+      _out << "PandaProducer stream " << (pid - 1);
+    _out << "\"}}," << std::endl;
+  }
+
+  _out << std::fixed << std::setprecision(3);
+
+  for (unsigned iR(0); iR != records_.size(); ++iR) {
+    auto& rec(records_[iR]);
+
+    _out << "{\"name\": \"" << rec.name << "\", \"cat\": \"" << rec.category << "\", \"ph\": \"X\""
+         << ", \"ts\": " << toUS(rec.begin - origin) << ", \"dur\": " << toUS(rec.duration)
+         << ", \"pid\": " << rec.pid << ", \"tid\": " << rec.tid;
+
+    if (rec.run != 0) {
+      _out << ", \"args\": {\"run\": " << rec.run;
+      if (rec.lumi != 0)
+        _out << ", \"lumi\": " << rec.lumi;
+      if (rec.event != 0)
+        _out << ", \"event\": " << rec.event;
+      _out << "}";
+    }
+
+    _out << "}";
+    if (iR != records_.size() - 1)
+      _out << ",";
+    _out << std::endl;
+  }
+
+  _out << "]}" << std::endl;
+}
+
+/*static*/
+unsigned
+TraceRecorder::threadIndex()
+{
+  static std::atomic<unsigned> nThreads(0);
+  thread_local unsigned index(nThreads++);
+  return index;
+}
@@ -4,9 +4,7 @@
 
 #include "PandaTree/Framework/interface/IOUtils.h"
 
-#include "TDOMParser.h"
-#include "TXMLNode.h"
-#include "TXMLAttr.h"
+#include <regex>
 
 auto GetAll([](edm::BranchDescription const&)->bool { return true; });
 
@@ -18,6 +16,7 @@ WeightsFiller::WeightsFiller(std::string const& _name, edm::ParameterSet const&
     // Some samples have non-standard LHEEventProduct names
     // Using notifyNewProduct() to dynamically find the tag
     lheEventToken_.first = "lheEvent";
+    lheRunToken_.first = "lheRun";
 
     auto pdfTypeName(getParameter_<std::string>(_cfg, "pdfType", ""));
     if (pdfTypeName == "NNPDF3.0") {
@@ -48,7 +47,7 @@ WeightsFiller::branchNames(panda::utils::BranchList& _eventBranches, panda::util
   _eventBranches.emplace_back("weight");
   if (!isRealData_) {
     _eventBranches.emplace_back("genReweight");
-    // genParam is booked at the first encounter
+    // genParam is booked in the first beginRun, with the size given by the LHE run header
     _eventBranches.push_back("!genReweight.genParam");
   }
 }
@@ -124,7 +123,7 @@ WeightsFiller::fill(panda::Event& _outEvent, edm::Event const&, edm::EventSetup
 
   _outEvent.weight = central_;
 
-  if (bufferCounter_ == 0) // getLHEWeights was not called
+  if (lheEventToken_.second.isUninitialized()) // getLHEWeights was not called
     return;
 
   // Save the offset of normalized reweight factor from 1 for precision
@@ -148,15 +147,36 @@ WeightsFiller::fill(panda::Event& _outEvent, edm::Event const&, edm::EventSetup
 }
 
 void
-WeightsFiller::fillEndRun(panda::Run&, edm::Run const&, edm::EventSetup const&)
+WeightsFiller::fillBeginRun(panda::Run&, edm::Run const& _inRun, edm::EventSetup const&)
 {
-  if (!isRealData_ && bufferCounter_ < learningPhase) {
-    // Run boundary before getting out of learning phase
-    // It could be a genuine run boundary, but there is no way to tell -> we need to exit learning phase now
-    bookGenParam_();
+  if (isRealData_)
+    return;
+
+  auto* lheRun(getProductSafe_(_inRun, lheRunToken_));
+  if (!lheRun) {
+    // no header -> no signal weights in any stream
+    genParamBooked_ = true;
+    return;
+  }
+
+  auto&& wids(getSignalWeightIds_(*lheRun));
 
-    bufferCounter_ = 0xffffffff;
+  if (genParamBooked_) {
+    if (wids != wids_)
+      std::cerr << "[WeightsFiller::fillBeginRun] Run " << _inRun.run() << " lists different signal weights than the first run."
+                << " genParam keeps the layout of the first run." << std::endl;
+    return;
   }
+
+  wids_ = std::move(wids);
+  if (wids_.size() > panda::GenReweight::NMAX) {
+    std::cerr << "[WeightsFiller::fillBeginRun] " << wids_.size() << " signal weights in the LHE header;"
+              << " only the first " << panda::GenReweight::NMAX << " are saved." << std::endl;
+    wids_.resize(panda::GenReweight::NMAX);
+  }
+
+  bookGenParam_();
+  genParamBooked_ = true;
 }
 
 void
@@ -167,6 +187,11 @@ WeightsFiller::notifyNewProduct(edm::BranchDescription const& _bdesc, edm::Consu
     edm::InputTag tag(_bdesc.moduleLabel(), _bdesc.productInstanceName(), _bdesc.processName());
     lheEventToken_.second = _coll.consumes<LHEEventProduct>(tag);
   }
+  // same for the LHERunInfoProduct in a run
+  else if (_bdesc.unwrappedTypeID() == edm::TypeID(typeid(LHERunInfoProduct))) {
+    edm::InputTag tag(_bdesc.moduleLabel(), _bdesc.productInstanceName(), _bdesc.processName());
+    lheRunToken_.second = _coll.consumes<LHERunInfoProduct, edm::InRun>(tag);
+  }
 }
 
 void
@@ -188,19 +213,13 @@ WeightsFiller::getLHEWeights_(LHEEventProduct const& _lheEvent)
     catch (std::invalid_argument& ex) {
       // assumption: this is signal reweights
 
+      // assumption: weights always come in the same order as in the run header, but the list can be truncated
       if (iS >= wids_.size()) {
-        if (bufferCounter_ < learningPhase) {
-          // assumption: weights always come in the same order, but the list can be truncated
-          wids_.emplace_back(wgt.id);
-
-          unsigned nbinsx(hSumW_->GetNbinsX() + 1);
-          hSumW_->SetBins(nbinsx, 0., nbinsx);
-          hSumW_->GetXaxis()->SetBinLabel(nbinsx, wgt.id.c_str());
-        }
-        else {
-          std::cerr << "Found more signal weights after the learning phase - cannot handle it." << std::endl;
-          continue;
+        if (!unlistedWeightWarned_) {
+          std::cerr << "Found more signal weights than listed in the LHE run header - cannot handle it." << std::endl;
+          unlistedWeightWarned_ = true;
         }
+        continue;
       }
 
       // unlike QCD weights, we simply save normalized weights to the tree
@@ -239,17 +258,36 @@ WeightsFiller::getLHEWeights_(LHEEventProduct const& _lheEvent)
     else if (id >= pdfBegin_ && id < pdfEnd_)
       normPDFVariations_[id - pdfBegin_] = wgt.wgt / lheCentral;
   }
+}
 
-  if (bufferCounter_ < learningPhase) {
-    // save the weights to the buffer
-    std::copy(genParam_, genParam_ + iS, genParamBuffer_[bufferCounter_]);
-    ++bufferCounter_;
-  }
-  else if (bufferCounter_ == learningPhase) {
-    // By now we should know how large the signal weights vector is
-    bookGenParam_();
-    bufferCounter_ = 0xffffffff;
+std::vector<TString>
+WeightsFiller::getSignalWeightIds_(LHERunInfoProduct const& _lheRun) const
+{
+  std::regex const weightTag("<weight\\s(?:[^>]*\\s)?id\\s*=\\s*[\"']([^\"']*)[\"']");
+
+  std::vector<TString> wids;
+
+  for (auto hItr(_lheRun.headers_begin()); hItr != _lheRun.headers_end(); ++hItr) {
+    if (hItr->tag() != "initrwgt")
+      continue;
+
+    std::string text;
+    for (auto& line : hItr->lines())
+      text += line;
+
+    for (std::sregex_iterator mItr(text.begin(), text.end(), weightTag); mItr != std::sregex_iterator(); ++mItr) {
+      std::string id((*mItr)[1]);
+      // same classification as getLHEWeights_: ids that are not integers are signal reweights
+      try {
+        std::stoi(id);
+      }
+      catch (std::invalid_argument& ex) {
+        wids.emplace_back(id.c_str());
+      }
+    }
   }
+
+  return wids;
 }
 
 void
@@ -258,6 +296,11 @@ WeightsFiller::bookGenParam_()
   if (wids_.size() == 0)
     return;
 
+  unsigned nbinsx(hSumW_->GetNbinsX());
+  hSumW_->SetBins(nbinsx + wids_.size(), 0., nbinsx + wids_.size());
+  for (unsigned iS(0); iS != wids_.size(); ++iS)
+    hSumW_->GetXaxis()->SetBinLabel(nbinsx + iS + 1, wids_[iS]);
+
   TDirectory::TContext context(outputFile_);
 
   auto* weightTree(new TTree("weights", "weights"));
@@ -269,13 +312,9 @@ WeightsFiller::bookGenParam_()
     weightTree->Fill();
   }
 
+  // booked before the first event of the stream -> no entries to backfill
   auto* eventTree(static_cast<TTree*>(outputFile_->Get("events")));
-  auto* branch(eventTree->Branch("genReweight.genParam", genParam_, TString::Format("genParam[%d]/F", int(wids_.size()))));
-
-  for (unsigned iE(0); iE != learningPhase; ++iE) {
-    std::copy(genParamBuffer_[iE], genParamBuffer_[iE] + wids_.size(), genParam_);
-    branch->Fill();
-  }
+  eventTree->Branch("genReweight.genParam", genParam_, TString::Format("genParam[%d]/F", int(wids_.size())));
 }
 
 DEFINE_TREEFILLER(WeightsFiller);
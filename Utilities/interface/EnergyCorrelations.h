@@ -116,8 +116,29 @@ namespace pandaecf {
 
     data_type access(int pos) const { return access(_oneToThree(pos)); }
     data_type access(pos_type pos) const;
+    /**
+     * \brief compute all ECFs of the given particles
+     * Particle eta, phi and the pairwise dR^2 are computed in single precision (the original
+     * implementation used double); the pT products and ECF sums are accumulated in double.
+     */
     void calculate(const std::vector<fastjet::PseudoJet>&);
 
+    /**
+     * \brief truncate the N=4 sum at a relative tolerance (0 = exact, default)
+     * With a nonzero tolerance, particles are processed in decreasing pT and the N=4 loop is
+     * terminated once the pT products of all remaining quadruplets sum to less than tolerance
+     * times those already processed. The resulting error on each ECF is bounded using the
+     * angles and reported by truncationError().
+     */
+    void setTolerance(double tolerance) { _tolerance = tolerance; }
+    double getTolerance() const { return _tolerance; }
+    /**
+     * \brief upper bound on the relative truncation error of an ECF in the last calculate()
+     * The truncated value is always an underestimate. 0 if the sum was not truncated.
+     */
+    double truncationError(pos_type pos) const { return _errors[_threeToOne(pos)]; }
+    double maxTruncationError() const;
+
     // just a forward iterator
     class iterator {
     private:
@@ -153,12 +174,32 @@ namespace pandaecf {
                                                  + (_oN * std::get<nP>(pos)) 
                                                  + (_oN * _nN * std::get<bP>(pos)); }
 
+    /**
+     * \brief fill dR2 of particle iP with particles 0..iP-1 into out[0..iP-1]
+     * Uses an AVX2 kernel if the CPU supports it (checked at run time), a scalar loop otherwise;
+     * both give identical results
+     */
+    void _fillDR2Row(int iP, float* out) const;
+    /**
+     * \brief index of the pair (iP, jP), jP < iP, in the packed lower-triangular buffers
+     */
+    static int _pairIndex(int iP, int jP) { return iP * (iP - 1) / 2 + jP; }
+
     std::vector<float> _bs;
     std::vector<int> _ns, _os;
     const int _bN, _nN, _oN;
     std::vector<double> _ecfs;
-    std::vector<double> pT; // these are member variables just to avoid
-    std::vector<std::vector<double>> dR, dRBeta; // re-allocating memory 
+    double _tolerance{0.};
+    std::vector<double> _errors;
+    // these are member variables just to avoid re-allocating memory
+    std::vector<double> pT;
+    std::vector<float> eta, phi; // SoA copy of the particle kinematics
+    std::vector<float> dR; // packed lower triangle of dR^2
+    std::vector<double> logDR; // log(dR^2) of each pair
+    std::vector<double> dRBeta; // (dR^2)^(beta/2), [pair][beta]
+    std::vector<double> vals; // ECF accumulators
+    std::vector<int> order; // pT ordering of the input (truncated mode only)
+    std::vector<double> tail4; // pT products and error bounds of the quadruplets whose softest particle is >= i
   };
 }
 
@@ -4,6 +4,7 @@
 #include <vector>
 #include <algorithm>
 #include <math.h>
+#include <atomic>
 #include "fastjet/PseudoJet.hh"
 #include "fastjet/ClusterSequence.hh"
 #include "fastjet/tools/Pruner.hh"
@@ -161,7 +162,7 @@ private:
   std::vector<PseudoJet> _top_hadrons;
   std::vector<PseudoJet> _top_parts;
 
-  static bool _first_time;
+  static std::atomic<bool> _first_time;
   double _qweight;
   
   //internal functions
@@ -285,9 +286,15 @@ public:
   }
   //  void set_qjets_rng(CLHEP::HepRandomEngine* engine){ _rnEngine = engine;}
 
+  // In the optimal-R scan, a subjet that is not unclustered further at the next R is the same
+  // node of the clustering history, so its fixed-R tagger result can be reused instead of rerun.
+  // Disable to rerun every subjet at every R (original behavior). Ignored with Q-jets.
+  void set_reuse_subjets(bool x) {_reuse_subjets = x;}
+
    
 private:
   bool _do_optimalR, _do_qjets;
+  bool _reuse_subjets{true};
  
   PseudoJet _jet;
   PseudoJet _initial_jet;
@@ -93,6 +93,12 @@ public:
 
   //  void set_rng(CLHEP::HepRandomEngine* engine){ engine_ = engine;}
 
+  /// reuse fixed-R results of unchanged subjets in the optimal-R scan (default true)
+  void setReuseSubjets(bool reuse) { reuseSubjets_ = reuse; }
+  /// compute the (un)filtered N-subjettiness of the structure in optimal-R mode (default true);
+  /// the Tau*() accessors return -1 when disabled
+  void setComputeNsubjettiness(bool compute) { computeNsubjettiness_ = compute; }
+
   // the type of the associated structure
   typedef HEPTopTaggerV2Structure StructureType;
 
@@ -130,6 +136,9 @@ private:
     bool optRrejectMin_; // set Ropt to zero for candidates that never leave the window around the initial mass
                          // otherwise (default) set them to R=0.5
 
+    bool reuseSubjets_{true};
+    bool computeNsubjettiness_{true};
+
     // Random engine for Q-jet HTT
     //    CLHEP::HepRandomEngine* engine_;
 };
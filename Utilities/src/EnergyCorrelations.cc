@@ -7,6 +7,13 @@
 #define PI 3.141592654
 
 #include <iostream>
+#include <cmath>
+#include <algorithm>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define PANDAECF_X86
+#include <immintrin.h>
+#endif
 
 using namespace pandaecf;
 using namespace std;
@@ -36,6 +43,15 @@ C::Calculator(int maxN, vector<float> bs):
   for (int i = 0; i != maxN; ++i)
     _ns[i] = i + 1;
   _ecfs.resize(_nN * _oN * _bN);
+  _errors.resize(_nN * _oN * _bN);
+}
+
+double C::maxTruncationError() const
+{
+  double maxError{0};
+  for (double err : _errors)
+    maxError = std::max(maxError, err);
+  return maxError;
 }
 
 C::data_type C::access(C::pos_type pos) const
@@ -60,162 +76,349 @@ C::pos_type C::_oneToThree(int pos) const
   return make_tuple(oI, nI, bI);
 }
 
+namespace {
+  /**
+   * \brief dR2 of (etaI, phiI) with particles jP..iP-1, scalar version
+   * Branch-free so that the compiler can vectorize it with whatever the build flags allow
+   */
+  void fillDR2Scalar(float etaI, float phiI, const float* eta, const float* phi, int jP, int iP, float* out)
+  {
+    const float pi = PI;
+    const float twoPi = 2 * PI;
+
+    for (; jP < iP; ++jP) {
+      float dEta = etaI - eta[jP];
+      float dPhi = phiI - phi[jP];
+      dPhi += (dPhi < -pi ? twoPi : 0.f);
+      dPhi -= (dPhi > pi ? twoPi : 0.f);
+      out[jP] = dEta * dEta + dPhi * dPhi;
+    }
+  }
+
+#ifdef PANDAECF_X86
+  /**
+   * \brief AVX2 version of fillDR2Scalar
+   * Compiled for AVX2 regardless of the build flags and only called if the CPU supports it.
+   * Same float operations as the scalar version (no FMA), so both give identical results.
+   */
+  __attribute__((target("avx2")))
+  void fillDR2AVX2(float etaI, float phiI, const float* eta, const float* phi, int iP, float* out)
+  {
+    const __m256 vEta = _mm256_set1_ps(etaI);
+    const __m256 vPhi = _mm256_set1_ps(phiI);
+    const __m256 vPi = _mm256_set1_ps(PI);
+    const __m256 vMinusPi = _mm256_set1_ps(-PI);
+    const __m256 vTwoPi = _mm256_set1_ps(2 * PI);
+
+    int jP = 0;
+    for (; jP + 8 <= iP; jP += 8) {
+      __m256 dEta = _mm256_sub_ps(vEta, _mm256_loadu_ps(eta + jP));
+      __m256 dPhi = _mm256_sub_ps(vPhi, _mm256_loadu_ps(phi + jP));
+      // bring dPhi back to [-pi, pi]
+      __m256 below = _mm256_cmp_ps(dPhi, vMinusPi, _CMP_LT_OQ);
+      __m256 above = _mm256_cmp_ps(dPhi, vPi, _CMP_GT_OQ);
+      dPhi = _mm256_add_ps(dPhi, _mm256_and_ps(below, vTwoPi));
+      dPhi = _mm256_sub_ps(dPhi, _mm256_and_ps(above, vTwoPi));
+      _mm256_storeu_ps(out + jP, _mm256_add_ps(_mm256_mul_ps(dEta, dEta), _mm256_mul_ps(dPhi, dPhi)));
+    }
+
+    fillDR2Scalar(etaI, phiI, eta, phi, jP, iP, out);
+  }
+
+  bool cpuHasAVX2()
+  {
+    __builtin_cpu_init(); // may run before the constructors of libgcc
+    return __builtin_cpu_supports("avx2");
+  }
+
+  bool const useAVX2 = cpuHasAVX2();
+#endif
+}
+
+void C::_fillDR2Row(int iP, float* out) const
+{
+#ifdef PANDAECF_X86
+  if (useAVX2) {
+    fillDR2AVX2(eta[iP], phi[iP], eta.data(), phi.data(), iP, out);
+    return;
+  }
+#endif
+
+  fillDR2Scalar(eta[iP], phi[iP], eta.data(), phi.data(), 0, iP, out);
+}
+
 void C::calculate(const vector<fastjet::PseudoJet>& particles)
 {
   if (_nN == 0 || _bN == 0 || _oN == 0)
     return;
 
   int nParticles = particles.size();
+  int nPairs = nParticles * (nParticles - 1) / 2;
 
   // cache kinematics
-  if (nParticles > (int)pT.size()) { 
-    pT.resize(nParticles, 0); dR.resize(nParticles); dRBeta.resize(nParticles);
-    for (int iP=0; iP!=nParticles; ++iP) {
-      dR[iP].resize(nParticles, 0);
-      dRBeta[iP].resize(nParticles, 0);
-    }
+  // eta, phi, pt are computed once per particle (PseudoJet::eta() and phi() are not free)
+  if (nParticles > (int)pT.size()) {
+    pT.resize(nParticles);
+    eta.resize(nParticles);
+    phi.resize(nParticles);
+    dR.resize(nPairs);
+    logDR.resize(nPairs);
+    dRBeta.resize(nPairs * _bN);
+  }
+
+  bool truncate{_tolerance > 0. && _nN > 3};
+
+  if (truncate) {
+    // truncation needs particles in decreasing pT, so that the softest member of a quadruplet is the
+    // one with the largest index
+    order.resize(nParticles);
+    for (int iP=0; iP!=nParticles; ++iP)
+      order[iP] = iP;
+    std::sort(order.begin(), order.end(), [&particles](int i1, int i2) {
+        return particles[i1].perp2() > particles[i2].perp2();
+      });
   }
 
   for (int iP=0; iP!=nParticles; ++iP) {
-    const fastjet::PseudoJet& pi = particles[iP];
+    const fastjet::PseudoJet& pi = particles[truncate ? order[iP] : iP];
     pT[iP] = pi.perp();
-    for (int jP=0; jP!=iP; ++jP) {
-      if (iP == jP) {
-        dR[iP][jP] = 0;
-      } else { 
-        const fastjet::PseudoJet& pj = particles[jP];
-        dR[iP][jP] = DeltaR2(pi,pj);
+    eta[iP] = pi.eta();
+    phi[iP] = pi.phi();
+  }
+
+  // packed lower triangle: row iP holds the pairs (iP, 0..iP-1) contiguously
+  for (int iP=1; iP < nParticles; ++iP)
+    _fillDR2Row(iP, &dR[_pairIndex(iP, 0)]);
+
+  // reweight angles for all betas in one pass
+  // dRBeta is pair-major: the _bN powers of one pair are contiguous, so that the ECF loop below can
+  // accumulate all betas at once
+  // common exponents are done exactly, the rest through a single log per pair
+  bool needLog{false};
+  for (int bI = 0; bI != _bN; ++bI) {
+    float halfBeta{_bs[bI] / 2.f};
+    if (halfBeta != 0.5f && halfBeta != 1.f && halfBeta != 2.f)
+      needLog = true;
+  }
+  if (needLog) {
+    for (int iR = 0; iR != nPairs; ++iR)
+      logDR[iR] = dR[iR] > 0. ? log(double(dR[iR])) : -HUGE_VAL;
+  }
+
+  for (int bI = 0; bI != _bN; ++bI) {
+    double halfBeta{_bs[bI] / 2.};
+    double* out = &dRBeta[bI];
+
+    if (halfBeta == 0.5) {
+      for (int iR = 0; iR != nPairs; ++iR)
+        out[iR * _bN] = sqrt(double(dR[iR]));
+    }
+    else if (halfBeta == 1.) {
+      for (int iR = 0; iR != nPairs; ++iR)
+        out[iR * _bN] = dR[iR];
+    }
+    else if (halfBeta == 2.) {
+      for (int iR = 0; iR != nPairs; ++iR)
+        out[iR * _bN] = double(dR[iR]) * dR[iR];
+    }
+    else {
+      for (int iR = 0; iR != nPairs; ++iR)
+        out[iR * _bN] = exp(halfBeta * logDR[iR]);
+    }
+  }
+
+  std::fill(_errors.begin(), _errors.end(), 0.);
+
+  if (truncate) {
+    // Quadruplets are pruned on their pT products alone: the N=4 loop stops at the softest particle i
+    // once the pT products of all quadruplets whose softest particle is >= i sum to less than
+    // tolerance times those of the quadruplets already processed. The error is then bounded using the
+    // angles: the two smallest of the six angles of (i, j, k, l) are not larger than the two smallest
+    // of the three angles involving i, whose product is in turn bounded by (a_ij * a_ik * a_il)^(2/3).
+    // Similarly the smallest angle is bounded by (a_ij * a_ik * a_il)^(1/3). Summing over the triplets
+    // j > k > l of harder particles gives
+    //   pT products: pT[i] * e3(pT[0], ..., pT[i-1])
+    //   bound(i, order, beta): pT[i] * e3(w[0], ..., w[i-1]),  w[m] = pT[m] * a_im^((order+1)/3)
+    // (e3: elementary symmetric polynomial = sum of the products of all triplets).
+    // tail4[i] holds the sums over i' >= i, [i][pT products, order 0 betas, order 1 betas].
+    const int nT = 1 + 2 * _bN;
+    tail4.assign((nParticles + 1) * nT, 0.);
+    double e1{0}, e2{0}, e3{0};
+    for (int iP = 0; iP != nParticles; ++iP) {
+      double* tail = &tail4[iP * nT];
+      tail[0] = pT[iP] * e3;
+      e3 += pT[iP] * e2;
+      e2 += pT[iP] * e1;
+      e1 += pT[iP];
+
+      const int row_i = _pairIndex(iP, 0);
+      for (int bI = 0; bI != _bN; ++bI) {
+        double we1[2]{}, we2[2]{}, we3[2]{};
+        for (int mP = 0; mP != iP; ++mP) {
+          double a13 = cbrt(dRBeta[(row_i + mP) * _bN + bI]);
+          double w[2] = {pT[mP] * a13, pT[mP] * a13 * a13};
+          for (int oI = 0; oI != 2; ++oI) {
+            we3[oI] += w[oI] * we2[oI];
+            we2[oI] += w[oI] * we1[oI];
+            we1[oI] += w[oI];
+          }
+        }
+        tail[1 + bI] = pT[iP] * we3[0];
+        tail[1 + _bN + bI] = pT[iP] * we3[1];
       }
     }
+    for (int iP = nParticles - 1; iP >= 0; --iP) {
+      for (int iT = 0; iT != nT; ++iT)
+        tail4[iP * nT + iT] += tail4[(iP + 1) * nT + iT];
+    }
   }
 
   // get the normalization factor
   double baseNorm{0};
-  for (auto& pt : pT)
-    baseNorm += pt;
+  for (int iP = 0; iP != nParticles; ++iP)
+    baseNorm += pT[iP];
   double norm2{pow(baseNorm, 2)};
   double norm3{pow(baseNorm, 3)};
   double norm4{pow(baseNorm, 4)};
 
-  vector<vector<double>> vals(_nN);
-  for (int nI = 0; nI != _nN; ++nI) {
-    vals[nI].resize(_oN, 0);
-  }
-
+  // trivial case, n = 1
   for (int bI = 0; bI != _bN; ++bI) {
-    
-    // reweight angles
-    double halfBeta{_bs[bI] / 2.};
-    for (int iP=0; iP!=nParticles; ++iP) {
-      for (int jP=0; jP!=iP; ++jP) {
-        if (iP == jP)
-          dRBeta[iP][jP] = 0;
-        else
-          dRBeta[iP][jP] = pow(dR[iP][jP], halfBeta);
-      }
-    }
-
-    // now we compute the ECFNs
-    // trivial case, n = 1
     for (int oI = 0; oI != _oN; ++oI) {
       _set(make_tuple(oI, 0, bI), 1);
     }
+  }
 
-    if (_nN < 2)
-      continue;
+  if (_nN < 2)
+    return;
 
-    // reset the accumulators
-    for (auto& v : vals) 
-      std::fill(v.begin(), v.end(), 0);
+  // accumulators, [N-1][order][beta]
+  // x -> x^(beta/2) is monotonic, so the ordering of the angles is the same for all betas. Angles are
+  // therefore ranked once on the raw dR^2, and the sums of all betas are accumulated in the same pass.
+  vals.assign(4 * 3 * _bN, 0.);
+  double* vals2 = &vals[(1 * 3 + 0) * _bN];
+  double* vals3[3] = {&vals[(2 * 3 + 0) * _bN], &vals[(2 * 3 + 1) * _bN], &vals[(2 * 3 + 2) * _bN]};
+  double* vals4[2] = {&vals[(3 * 3 + 0) * _bN], &vals[(3 * 3 + 1) * _bN]};
+
+  // in truncated mode, set to true once the pT products of the remaining quadruplets are negligible
+  bool skip4{false};
+
+  // now we loop
+  for (int iP = 0; iP != nParticles; ++iP) {
+    if (truncate && !skip4) {
+      const int nT = 1 + 2 * _bN;
+      const double* tail = &tail4[iP * nT];
+      if (tail[0] <= _tolerance * (tail4[0] - tail[0])) {
+        // a relative error needs a nonzero partial sum; otherwise keep summing (no truncation yet)
+        skip4 = true;
+        for (int oI = 0; oI != 2 && oI != _oN; ++oI) {
+          for (int bI = 0; bI != _bN; ++bI) {
+            if (tail[1 + oI * _bN + bI] > 0. && !(vals4[oI][bI] > 0.))
+              skip4 = false;
+          }
+        }
+        if (skip4) {
+          for (int oI = 0; oI != 2 && oI != _oN; ++oI) {
+            for (int bI = 0; bI != _bN; ++bI) {
+              double bound = tail[1 + oI * _bN + bI];
+              if (bound > 0.)
+                _errors[_threeToOne(make_tuple(oI, 3, bI))] = bound / vals4[oI][bI];
+            }
+          }
+        }
+      }
+    }
 
-    // now we loop
-    vector<double> angles3(3), angles4(6); // N(N-1)/2
-    for (int iP = 0; iP != nParticles; ++iP) {
-      for (int jP = 0; jP != iP; ++jP) {
-        const double pt_ij = pT[iP] * pT[jP];
-        const double angle_ij = dRBeta[iP][jP];
-
-        vals[1][0] += pt_ij * angle_ij;
-
-        if (_nN > 2) { 
-          for (int kP = 0; kP != jP; ++kP) {
-            const double angle_ik = dRBeta[iP][kP], angle_jk = dRBeta[jP][kP];
-            const double pt_ijk = pt_ij * pT[kP];
-
-            angles3[0] = angle_ij; 
-            angles3[1] = angle_ik; 
-            angles3[2] = angle_jk;
-
-            insertion_sort(angles3);
-            
-            // unrolling this appears to be faster than a for loop
-            double inc3 = pt_ijk * angles3[0];
-            vals[2][0] += inc3;
-            inc3 *= angles3[1]; vals[2][1] += inc3;
-            inc3 *= angles3[2]; vals[2][2] += inc3;
-
-
-            if (_nN > 3) {
-              // Set these outside of the  lP loop as long as the sorting
-              // algorithm we use is not in-place 
-              // If we are using an in-place sort, this needs to be moved down
-              angles4[0] = angle_ij;
-              angles4[1] = angle_ik;
-              angles4[2] = angle_jk;
-
-              for (int lP = 0; lP != kP; ++lP) {
-                const double pt_ijkl = pt_ijk * pT[lP];
-                angles4[3] = dRBeta[iP][lP]; 
-                angles4[4] = dRBeta[jP][lP];
-                angles4[5] = dRBeta[kP][lP];
-
-                // The best-performing algorithm to find the 2- or 
-                // 3-smallest elements appears to be as below. 
-                // I have a number of other options in the header that were tested, 
-                // all demonstrably worse. 
-                // The exact performance of this sorting is critical, since it's called 
-                // O(4e8) times/event.
-                // "This is the worst sorting algorithm, except for all the other
-                // ones that have been tried" -Winsort Churchill
-                double angle1=999, angle2=999;
-                int idx_1=-1;
-                for (int iA = 0; iA != 6; ++iA) {
-                  if (angles4[iA] < angle1) {
-                    angle1 = angles4[iA];
-                    idx_1 = iA;
-                  }
-                }
-                for (int iA = 0; iA != 6; ++iA) {
-                  if (iA == idx_1)
-                    continue;
-                  if (angles4[iA] < angle2) {
-                    angle2 = angles4[iA];
-                  }
-                }
-
-
-                // again prefer to unroll
-                double inc4 = pt_ijkl * angle1;
-                vals[3][0] += inc4;
-                inc4 *= angle2; vals[3][1] += inc4;
-                
-              } // l
-            } // N > 3
-
-          } // k
-        } // N > 2
-      } // j
-    } // i
-
-  
-    // set the values
-    double val2 = vals[1][0];
-    val2 /= norm2;
-    for (int oI = 0; oI != _oN; ++oI) {
-      _set(make_tuple(oI, 1, bI), val2);
-      _set(make_tuple(oI, 2, bI), vals[2][oI] / norm3);
-      _set(make_tuple(oI, 3, bI), vals[3][oI] / norm4);
+    const int row_i = _pairIndex(iP, 0);
+    for (int jP = 0; jP != iP; ++jP) {
+      const int row_j = _pairIndex(jP, 0);
+      const double pt_ij = pT[iP] * pT[jP];
+      const int ij = row_i + jP;
+      const double* angle_ij = &dRBeta[ij * _bN];
+
+      for (int bI = 0; bI != _bN; ++bI)
+        vals2[bI] += pt_ij * angle_ij[bI];
+
+      if (_nN < 3)
+        continue;
+
+      for (int kP = 0; kP != jP; ++kP) {
+        const int row_k = _pairIndex(kP, 0);
+        const double pt_ijk = pt_ij * pT[kP];
+
+        // pair indices, ranked below by dR^2
+        int pairs3[3] = {ij, row_i + kP, row_j + kP};
+
+        // three-element sorting network
+        if (dR[pairs3[1]] < dR[pairs3[0]])
+          std::swap(pairs3[0], pairs3[1]);
+        if (dR[pairs3[2]] < dR[pairs3[1]]) {
+          std::swap(pairs3[1], pairs3[2]);
+          if (dR[pairs3[1]] < dR[pairs3[0]])
+            std::swap(pairs3[0], pairs3[1]);
+        }
+
+        const double* a0 = &dRBeta[pairs3[0] * _bN];
+        const double* a1 = &dRBeta[pairs3[1] * _bN];
+        const double* a2 = &dRBeta[pairs3[2] * _bN];
+
+        // unrolling this appears to be faster than a for loop
+        for (int bI = 0; bI != _bN; ++bI) {
+          double inc3 = pt_ijk * a0[bI];
+          vals3[0][bI] += inc3;
+          inc3 *= a1[bI]; vals3[1][bI] += inc3;
+          inc3 *= a2[bI]; vals3[2][bI] += inc3;
+        }
+
+        if (_nN < 4 || skip4)
+          continue;
+
+        for (int lP = 0; lP != kP; ++lP) {
+          const double pt_ijkl = pt_ijk * pT[lP];
+
+          int pairs4[6] = {ij, row_i + kP, row_j + kP, row_i + lP, row_j + lP, row_k + lP};
+
+          // The exact performance of this selection is critical, since it's called
+          // O(4e6) times per jet. Only the two smallest angles are needed.
+          int idx1 = pairs4[0];
+          int idx2 = -1;
+          float angle1 = dR[idx1];
+          float angle2 = 999.;
+          for (int iA = 1; iA != 6; ++iA) {
+            float angle = dR[pairs4[iA]];
+            if (angle < angle1) {
+              angle2 = angle1;
+              idx2 = idx1;
+              angle1 = angle;
+              idx1 = pairs4[iA];
+            }
+            else if (angle < angle2 || idx2 < 0) {
+              angle2 = angle;
+              idx2 = pairs4[iA];
+            }
+          }
+
+          const double* b1 = &dRBeta[idx1 * _bN];
+          const double* b2 = &dRBeta[idx2 * _bN];
+
+          for (int bI = 0; bI != _bN; ++bI) {
+            double inc4 = pt_ijkl * b1[bI];
+            vals4[0][bI] += inc4;
+            inc4 *= b2[bI]; vals4[1][bI] += inc4;
+          }
+        } // l
+      } // k
+    } // j
+  } // i
+
+  // set the values
+  double norms[] = {1., norm2, norm3, norm4};
+  for (int bI = 0; bI != _bN; ++bI) {
+    for (int nI = 1; nI < _nN && nI < 4; ++nI) {
+      for (int oI = 0; oI != _oN; ++oI) {
+        // N = 2 has only one order
+        double val = vals[(nI * 3 + (nI == 1 ? 0 : oI)) * _bN + bI];
+        _set(make_tuple(oI, nI, bI), val / norms[nI]);
+      }
     }
-  } // beta loop
+  }
 }
-
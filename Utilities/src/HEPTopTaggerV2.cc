@@ -8,11 +8,11 @@ double R_opt_calc_funct(double pt_filt) {
   return 327./pt_filt;
 }
 
-bool HEPTopTaggerV2_fixed_R::_first_time = true;
+std::atomic<bool> HEPTopTaggerV2_fixed_R::_first_time(true);
 
 void HEPTopTaggerV2_fixed_R::print_banner() {
-  if (!_first_time) {return;}
-  _first_time = false;
+  // taggers of all streams share the flag; only the first caller prints
+  if (!_first_time.exchange(false)) {return;}
 
   std::cout << "#--------------------------------------------------------------------------\n";
   std::cout << "#                   HEPTopTaggerV2 - under construction                      \n";
@@ -503,6 +503,10 @@ void HEPTopTaggerV2::run() {
   
     big_fatjets.push_back(_jet);
     _Ropt = 0;
+
+    // fixed-R results keyed by the cluster history index of the subjet
+    bool reuse = _reuse_subjets && !_do_qjets;
+    map<int, HEPTopTaggerV2_fixed_R> fixed_R_results;
     
     for (int R = maxR; R >= minR; R -= stepR) {
       UnclusterFatjets(big_fatjets, small_fatjets, *_seq, R / 10.);
@@ -515,6 +519,17 @@ void HEPTopTaggerV2::run() {
       double dummy = -99999;
 
       for (unsigned i = 0; i < small_fatjets.size(); i++) {
+	if (reuse) {
+	  auto cached = fixed_R_results.find(small_fatjets[i].cluster_hist_index());
+	  if (cached != fixed_R_results.end()) {
+	    if (cached->second.t().perp() > dummy) {
+	      dummy = cached->second.t().perp();
+	      _HEPTopTaggerV2[R] = cached->second;
+	    }
+	    continue;
+	  }
+	}
+
 	HEPTopTaggerV2_fixed_R htt(small_fatjets[i]);
 	htt.set_mass_drop_threshold(_mass_drop_threshold);
 	htt.set_max_subjet_mass(_max_subjet_mass);
@@ -536,6 +551,9 @@ void HEPTopTaggerV2::run() {
 	htt.set_qjets(_q_zcut, _q_dcut_fctr, _q_exp_min, _q_exp_max, _q_rigidity, _q_truncation_fctr);
 
 	htt.run();
+
+	if (reuse)
+	  fixed_R_results[small_fatjets[i].cluster_hist_index()] = htt;
      
 	if (htt.t().perp() > dummy) {
 	  dummy = htt.t().perp();
@@ -570,8 +588,8 @@ void HEPTopTaggerV2::run() {
     _HEPTopTaggerV2_opt = _HEPTopTaggerV2[_Ropt];
   
     Filter filter_optimalR_calc(_R_filt_optimalR_calc, SelectorNHardest(_N_filt_optimalR_calc));
-    _R_opt_calc = _r_min_exp_function(filter_optimalR_calc(_fat).pt());
     _pt_for_R_opt_calc = filter_optimalR_calc(_fat).pt();
+    _R_opt_calc = _r_min_exp_function(_pt_for_R_opt_calc);
 
     Filter filter_optimalR_pass(_R_filt_optimalR_pass, SelectorNHardest(_N_filt_optimalR_pass));
     Filter filter_optimalR_fail(_R_filt_optimalR_fail, SelectorNHardest(_N_filt_optimalR_fail));
@@ -91,6 +91,7 @@ PseudoJet HEPTopTaggerV2::result(const PseudoJet & jet) const{
   // Optimal R
   tagger.do_optimalR(DoOptimalR_);
   tagger.set_optimalR_reject_minimum(optRrejectMin_);
+  tagger.set_reuse_subjets(reuseSubjets_);
 
   // How to select among candidates
   tagger.set_mode((external::Mode)mode_);
@@ -196,7 +197,7 @@ PseudoJet HEPTopTaggerV2::result(const PseudoJet & jet) const{
   s->_fRec = tagger.f_rec();
   s->_mass_ratio_passed = tagger.is_masscut_passed();
 
-  if (DoOptimalR_){
+  if (DoOptimalR_ && computeNsubjettiness_){
     s->_tau1Unfiltered = tagger.nsub_unfiltered(1);
     s->_tau2Unfiltered = tagger.nsub_unfiltered(2);
     s->_tau3Unfiltered = tagger.nsub_unfiltered(3);
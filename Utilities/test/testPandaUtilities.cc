@@ -0,0 +1,636 @@
+/**
+ * \file testPandaUtilities.cc
+ * \brief Benchmark and regression test of the PandaProd/Utilities algorithms
+ *
+ * Runs EnergyCorrelations, HEPTopTaggerV2, RoccoR and BoostedBtaggingMVACalculator on synthetic inputs
+ * generated with fixed seeds, prints the time per call, and compares the results with the values stored in
+ * testPandaUtilities_reference.txt. No cmsRun or input file is needed.
+ *
+ * Usage: testPandaUtilities [--update] [--no-timing] [--reference FILE] [--data DIR]
+ *   --update      write the current results to the reference file instead of comparing; this is the only way
+ *                 to add a value: a computed value without a reference, or a reference without a computed value,
+ *                 is a failure
+ *   --no-timing   run each configuration once (regression check only)
+ *   --reference   default $CMSSW_BASE/src/PandaProd/Utilities/test/testPandaUtilities_reference.txt
+ *   --data        directory with the RoccoR and BDT weight files, default $CMSSW_BASE/src/PandaProd/Utilities/data
+ *
+ * Besides the stored references, two self-consistency checks are made on every run: the truncated N=4 ECF sum
+ * must stay within its reported error bound, and the HEPTopTagger optimal-R scan must give identical results
+ * with and without subjet reuse.
+ * Returns 0 if all checks pass.
+ */
+
+#include "PandaProd/Utilities/interface/EnergyCorrelations.h"
+#include "PandaProd/Utilities/interface/HEPTopTaggerWrapperV2.h"
+#include "PandaProd/Utilities/interface/RoccoR.h"
+#include "PandaProd/Utilities/interface/BoostedBtaggingMVACalculator.h"
+
+#include "fastjet/ClusterSequence.hh"
+#include "fastjet/JetDefinition.hh"
+
+#include <random>
+#include <chrono>
+#include <map>
+#include <vector>
+#include <string>
+#include <cstring>
+#include <cstdio>
+#include <cstdarg>
+#include <cstdlib>
+#include <cmath>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include <functional>
+#include <memory>
+#include <stdexcept>
+
+namespace {
+
+  typedef std::chrono::steady_clock SClock;
+
+  //! Constituent multiplicities of the fat jets
+  unsigned const multiplicities[] = {10, 20, 50, 100, 150, 200, 300};
+  //! Jets per multiplicity; the first one is compared with the reference
+  unsigned const nJets(3);
+  //! Muons and BDT input sets
+  unsigned const nMuons(2000);
+  unsigned const nMVA(2000);
+  //! Number of individually stored RoccoR and BDT results (the rest enter through sums)
+  unsigned const nStored(20);
+
+  //! Relative tolerance of the comparison with the reference, and absolute floor for values near zero
+  double const relTolerance(2.e-6);
+  double const absTolerance(1.e-9);
+
+  //! Uniform and gaussian numbers from a fixed seed
+  //! Built on the raw mt19937_64 output, which is fully specified by the standard, so that the inputs do not
+  //! depend on the standard library implementation (std::*_distribution do).
+  class Random {
+  public:
+    Random(unsigned long long seed) : engine_(seed) {}
+
+    double uniform() { return (engine_() >> 11) * (1. / 9007199254740992.); }
+    double uniform(double min, double max) { return min + (max - min) * uniform(); }
+    double gaus(double mean, double sigma)
+    {
+      double u1(1. - uniform()); // (0, 1]
+      double u2(uniform());
+      return mean + sigma * std::sqrt(-2. * std::log(u1)) * std::cos(2. * M_PI * u2);
+    }
+
+  private:
+    std::mt19937_64 engine_;
+  };
+
+  struct Options {
+    bool update{false};
+    bool timing{true};
+    std::string reference{};
+    std::string data{};
+  };
+
+  //! Results keyed by name, written to / compared with the reference file
+  typedef std::map<std::string, double> Results;
+
+  std::string
+  key(char const* fmt, ...) __attribute__((format(printf, 1, 2)));
+
+  std::string
+  key(char const* fmt, ...)
+  {
+    char buf[256];
+    va_list args;
+    va_start(args, fmt);
+    std::vsnprintf(buf, sizeof(buf), fmt, args);
+    va_end(args);
+    return buf;
+  }
+
+  //! Run f nRepeat times and return the mean time per call in microseconds
+  double
+  timeCalls(unsigned nRepeat, std::function<void()> const& f)
+  {
+    auto start(SClock::now());
+    for (unsigned iR(0); iR != nRepeat; ++iR)
+      f();
+    return std::chrono::duration<double, std::micro>(SClock::now() - start).count() / nRepeat;
+  }
+
+  /**
+   * \brief Constituents of a synthetic boosted-top fat jet, sorted by decreasing pT
+   * Three prongs carrying 45%, 33%, and 22% of the jet pT, each a narrow gaussian spray, plus 10% of the
+   * particles spread uniformly over a disc of radius 1.2 with little pT. Massless particles.
+   */
+  std::vector<fastjet::PseudoJet>
+  makeFatJet(unsigned nConst, unsigned long long seed)
+  {
+    Random rnd(seed);
+
+    double const jetPt(600.);
+    double const axisEta(rnd.uniform(-1.5, 1.5));
+    double const axisPhi(rnd.uniform(-M_PI, M_PI));
+
+    double const fractions[3] = {0.45, 0.33, 0.22};
+    double prongEta[3];
+    double prongPhi[3];
+    for (unsigned iR(0); iR != 3; ++iR) {
+      double dist(rnd.uniform(0.2, 0.6));
+      double angle(rnd.uniform(0., 2. * M_PI));
+      prongEta[iR] = axisEta + dist * std::cos(angle);
+      prongPhi[iR] = axisPhi + dist * std::sin(angle);
+    }
+
+    struct Particle {
+      double w, eta, phi;
+    };
+    std::vector<Particle> particles(nConst);
+    double prongSum[3] = {0., 0., 0.};
+    double softSum(0.);
+    std::vector<int> prongOf(nConst);
+
+    for (unsigned iC(0); iC != nConst; ++iC) {
+      auto& p(particles[iC]);
+      if (rnd.uniform() < 0.1) {
+        double r(1.2 * std::sqrt(rnd.uniform()));
+        double angle(rnd.uniform(0., 2. * M_PI));
+        p.w = rnd.uniform();
+        p.eta = axisEta + r * std::cos(angle);
+        p.phi = axisPhi + r * std::sin(angle);
+        prongOf[iC] = -1;
+        softSum += p.w;
+      }
+      else {
+        double u(rnd.uniform());
+        int iR(u < fractions[0] ? 0 : (u < fractions[0] + fractions[1] ? 1 : 2));
+        p.w = std::exp(-3. * rnd.uniform());
+        p.eta = rnd.gaus(prongEta[iR], 0.05);
+        p.phi = rnd.gaus(prongPhi[iR], 0.05);
+        prongOf[iC] = iR;
+        prongSum[iR] += p.w;
+      }
+    }
+
+    // soft particles carry 2% of the jet pT, the prongs share the rest
+    double const softFraction(softSum > 0. ? 0.02 : 0.);
+    std::vector<fastjet::PseudoJet> constituents;
+    for (unsigned iC(0); iC != nConst; ++iC) {
+      auto& p(particles[iC]);
+      double pt;
+      if (prongOf[iC] < 0)
+        pt = jetPt * softFraction * p.w / softSum;
+      else if (prongSum[prongOf[iC]] > 0.)
+        pt = jetPt * (1. - softFraction) * fractions[prongOf[iC]] * p.w / prongSum[prongOf[iC]];
+      else
+        continue;
+
+      constituents.emplace_back(pt * std::cos(p.phi), pt * std::sin(p.phi), pt * std::sinh(p.eta), pt * std::cosh(p.eta));
+    }
+
+    std::sort(constituents.begin(), constituents.end(), [](fastjet::PseudoJet const& j1, fastjet::PseudoJet const& j2) {
+        return j1.perp2() > j2.perp2();
+      });
+
+    return constituents;
+  }
+
+  //! Synthetic muon kinematics for RoccoR
+  struct Muon {
+    int charge;
+    double pt, eta, phi;
+    int nLayers;
+    double genPt;
+    double u1, u2;
+  };
+
+  std::vector<Muon>
+  makeMuons(unsigned nMu, unsigned long long seed)
+  {
+    Random rnd(seed);
+
+    std::vector<Muon> muons(nMu);
+    for (auto& mu : muons) {
+      mu.charge = rnd.uniform() < 0.5 ? -1 : 1;
+      mu.pt = 20. * std::exp(rnd.uniform(0., std::log(10.))); // 20 - 200 GeV, falling
+      mu.eta = rnd.uniform(-2.4, 2.4);
+      mu.phi = rnd.uniform(-M_PI, M_PI);
+      mu.nLayers = 6 + int(rnd.uniform() * 12.); // 6 - 17
+      mu.genPt = mu.pt * (1. + rnd.gaus(0., 0.02));
+      mu.u1 = rnd.uniform();
+      mu.u2 = rnd.uniform();
+    }
+
+    return muons;
+  }
+
+  //! Number of BDT inputs (variables and spectators) of BoostedBtaggingMVACalculator::mvaValue
+  unsigned const nMVAInputs(33);
+
+  /**
+   * \brief Synthetic BDT inputs
+   * Each input is drawn uniformly within its training range (taken from the weight file header), with the
+   * integer-valued ones (flavour, nbHadrons, jetNTracks, nSV) rounded down.
+   */
+  std::vector<std::vector<float>>
+  makeMVAInputs(unsigned nSet, unsigned long long seed)
+  {
+    // massPruned, flavour, nbHadrons, ptPruned, etaPruned, then the 28 variables in the order of mvaValue
+    double const ranges[nMVAInputs][2] = {
+      {50., 200.}, {-5., 21.}, {0., 6.}, {170., 1800.}, {-2.57, 2.57},
+      {-1., 1.}, {-3., 742.}, {-50., 46.1}, {-50., 67.9}, {-50., 96.1},
+      {-50., 155.2}, {-50., 155.2}, {-50., 139.1}, {-50., 81.6}, {-50., 96.1},
+      {-56.0, 105.7}, {-128.0, 94.9}, {-104.1, 71.9}, {-1., 7.95}, {-1., 10.27},
+      {-1., 10.29}, {-1., 7.30}, {-1., 10.48}, {-1., 10.11}, {-1., 598.5},
+      {-1., 50.}, {-1., 1.80}, {-1., 521.4}, {-1., 388.3}, {-1., 50.},
+      {-1., 533.3}, {0., 58.}, {0., 11.}
+    };
+    bool const integer[nMVAInputs] = {
+      false, true, true, false, false,
+      false, false, false, false, false,
+      false, false, false, false, false,
+      false, false, false, false, false,
+      false, false, false, false, false,
+      false, false, false, false, false,
+      false, true, true
+    };
+
+    Random rnd(seed);
+
+    std::vector<std::vector<float>> inputs(nSet, std::vector<float>(nMVAInputs));
+    for (auto& set : inputs) {
+      for (unsigned iV(0); iV != nMVAInputs; ++iV) {
+        double x(rnd.uniform(ranges[iV][0], ranges[iV][1]));
+        set[iV] = integer[iV] ? std::floor(x) : x;
+      }
+    }
+
+    return inputs;
+  }
+
+  void
+  runECF(Options const& _opts, Results& _results, std::ostream& _report, unsigned& _nFailed)
+  {
+    pandaecf::Calculator exact;
+    pandaecf::Calculator truncated;
+    double const tolerance(1.e-3);
+    truncated.setTolerance(tolerance);
+
+    _report << std::endl << "EnergyCorrelations (N <= 4, beta = 0.5, 1, 2, 4), time per jet" << std::endl;
+    _report << std::setw(6) << "n" << std::setw(16) << "exact [us]" << std::setw(18) << "tol 1e-3 [us]" << std::setw(18) << "max trunc. err" << std::endl;
+
+    for (unsigned n : multiplicities) {
+      double tExact(0.);
+      double tTruncated(0.);
+      double maxError(0.);
+
+      // the exact sum takes seconds per jet above 200 constituents
+      unsigned nJ(n <= 100 ? nJets : 1);
+
+      for (unsigned iJ(0); iJ != nJ; ++iJ) {
+        auto&& constituents(makeFatJet(n, 1000 * n + iJ));
+
+        // the N=4 sum dominates; repeat small jets to get a measurable time
+        unsigned nRepeat(_opts.timing ? std::max(1u, 20000u / (n * n)) : 1);
+
+        tExact += timeCalls(nRepeat, [&exact, &constituents]() { exact.calculate(constituents); });
+        tTruncated += timeCalls(nRepeat, [&truncated, &constituents]() { truncated.calculate(constituents); });
+
+        for (auto eItr(exact.begin()), tItr(truncated.begin()); eItr != exact.end(); ++eItr, ++tItr) {
+          int oI(eItr.get<pandaecf::Calculator::oP>());
+          int nI(eItr.get<pandaecf::Calculator::nP>());
+          int bI(eItr.get<pandaecf::Calculator::bP>());
+          double value(eItr.get<pandaecf::Calculator::ecfP>());
+
+          if (iJ == 0)
+            _results[key("ecf.n%03u.o%d_N%d_b%d", n, oI + 1, nI + 1, bI)] = value;
+
+          // the truncated sum underestimates the exact one by at most the reported relative error
+          double bound(truncated.truncationError(std::make_tuple(oI, nI, bI)));
+          double diff(value - tItr.get<pandaecf::Calculator::ecfP>());
+          if (!std::isfinite(bound) || (value > 0. && diff / value > bound + relTolerance)) {
+            std::cerr << "FAIL ecf.n" << n << " jet " << iJ << " (" << oI + 1 << ", " << nI + 1 << ", " << bI << "): truncation error "
+                      << diff / value << " outside the reported bound " << bound << std::endl;
+            ++_nFailed;
+          }
+          if (std::isfinite(bound))
+            maxError = std::max(maxError, bound);
+        }
+      }
+
+      _report << std::setw(6) << n << std::setw(16) << std::fixed << std::setprecision(1) << tExact / nJ
+              << std::setw(18) << tTruncated / nJ << std::setw(18) << std::scientific << std::setprecision(2) << maxError << std::endl;
+      _report << std::defaultfloat;
+    }
+  }
+
+  void
+  runHTT(Options const& _opts, Results& _results, std::ostream& _report, unsigned& _nFailed)
+  {
+    // same configuration as FatJetsFiller
+    auto makeTagger([](bool reuse) {
+        std::unique_ptr<fastjet::HEPTopTaggerV2> tagger(new fastjet::HEPTopTaggerV2(true, false, // optimalR, Qjets
+                                       0., 0., // minSubjetPt, minCandPt
+                                       30., 0.8, // subjetMass, muCut
+                                       0.3, 5, // filtR, filtN
+                                       4, 0., // mode, minCandMass
+                                       9999999., 9999999., // maxCandMass, massRatioWidth
+                                       0., 0., // minM23Cut, minM13Cut
+                                       9999999., false)); // maxM13Cut, optRrejectMin
+        tagger->setReuseSubjets(reuse);
+        tagger->setComputeNsubjettiness(false);
+        return tagger;
+      });
+
+    auto tagger(makeTagger(true));
+    auto taggerNoReuse(makeTagger(false));
+
+    fastjet::JetDefinition jetDef(fastjet::cambridge_algorithm, 1.5);
+
+    _report << std::endl << "HEPTopTaggerV2 (optimal R, mode 4), time per jet" << std::endl;
+    _report << std::setw(6) << "n" << std::setw(16) << "CA1.5 [us]" << std::setw(16) << "HTT [us]" << std::setw(20) << "HTT no reuse [us]" << std::endl;
+
+    for (unsigned n : multiplicities) {
+      double tCluster(0.);
+      double tTag(0.);
+      double tTagNoReuse(0.);
+
+      for (unsigned iJ(0); iJ != nJets; ++iJ) {
+        auto&& constituents(makeFatJet(n, 1000 * n + iJ));
+
+        unsigned nRepeat(_opts.timing ? std::max(1u, 2000u / n) : 1);
+
+        std::vector<fastjet::PseudoJet> jets;
+        tCluster += timeCalls(nRepeat, [&]() {
+            fastjet::ClusterSequence seq(constituents, jetDef);
+            jets = fastjet::sorted_by_pt(seq.inclusive_jets(0.1));
+          });
+
+        // the tagger needs the cluster sequence of the jet alive
+        fastjet::ClusterSequence seq(constituents, jetDef);
+        jets = fastjet::sorted_by_pt(seq.inclusive_jets(0.1));
+        if (jets.empty())
+          continue;
+
+        auto& leadingJet(jets[0]);
+
+        fastjet::PseudoJet httJet;
+        fastjet::PseudoJet httJetNoReuse;
+        tTag += timeCalls(nRepeat, [&]() { httJet = tagger->result(leadingJet); });
+        tTagNoReuse += timeCalls(nRepeat, [&]() { httJetNoReuse = taggerNoReuse->result(leadingJet); });
+
+        double values[2][3] = {};
+        fastjet::PseudoJet const* results[2] = {&httJet, &httJetNoReuse};
+        for (unsigned iR(0); iR != 2; ++iR) {
+          if (*results[iR] == 0)
+            continue;
+          auto* s(static_cast<fastjet::HEPTopTaggerV2Structure const*>(results[iR]->structure_ptr()));
+          values[iR][0] = 1.;
+          values[iR][1] = s->top_mass();
+          values[iR][2] = s->fRec();
+        }
+
+        // reusing the subjets of the previous R must not change anything
+        if (std::memcmp(values[0], values[1], sizeof(values[0])) != 0) {
+          std::cerr << "FAIL htt.n" << n << " jet " << iJ << ": subjet reuse changes the result (top mass "
+                    << values[0][1] << " vs " << values[1][1] << ", fRec " << values[0][2] << " vs " << values[1][2] << ")" << std::endl;
+          ++_nFailed;
+        }
+
+        if (iJ == 0) {
+          _results[key("htt.n%03u.tagged", n)] = values[0][0];
+          _results[key("htt.n%03u.top_mass", n)] = values[0][1];
+          _results[key("htt.n%03u.fRec", n)] = values[0][2];
+        }
+      }
+
+      _report << std::setw(6) << n << std::fixed << std::setprecision(1) << std::setw(16) << tCluster / nJets
+              << std::setw(16) << tTag / nJets << std::setw(20) << tTagNoReuse / nJets << std::endl;
+      _report << std::defaultfloat;
+    }
+  }
+
+  void
+  runRoccoR(Options const& _opts, Results& _results, std::ostream& _report, unsigned&)
+  {
+    RoccoR roccor(_opts.data + "/RoccoR2017v0.txt");
+
+    auto&& muons(makeMuons(nMuons, 31415));
+
+    // same calls as MuonsFiller; RoccoR can throw for some combinations of parameters
+    char const* names[6] = {"kScaleDT", "kScaleDTerror", "kScaleAndSmearMC", "kScaleAndSmearMCerror", "kScaleFromGenMC", "kScaleFromGenMCerror"};
+    std::function<double(Muon const&)> corrections[6] = {
+      [&roccor](Muon const& mu) { return roccor.kScaleDT(mu.charge, mu.pt, mu.eta, mu.phi); },
+      [&roccor](Muon const& mu) { return roccor.kScaleDTerror(mu.charge, mu.pt, mu.eta, mu.phi); },
+      [&roccor](Muon const& mu) { return roccor.kScaleAndSmearMC(mu.charge, mu.pt, mu.eta, mu.phi, mu.nLayers, mu.u1, mu.u2); },
+      [&roccor](Muon const& mu) { return roccor.kScaleAndSmearMCerror(mu.charge, mu.pt, mu.eta, mu.phi, mu.nLayers, mu.u1, mu.u2); },
+      [&roccor](Muon const& mu) { return roccor.kScaleFromGenMC(mu.charge, mu.pt, mu.eta, mu.phi, mu.nLayers, mu.genPt, mu.u1); },
+      [&roccor](Muon const& mu) { return roccor.kScaleFromGenMCerror(mu.charge, mu.pt, mu.eta, mu.phi, mu.nLayers, mu.genPt, mu.u1); }
+    };
+
+    _report << std::endl << "RoccoR, time per muon (" << nMuons << " muons)" << std::endl;
+
+    for (unsigned iF(0); iF != 6; ++iF) {
+      std::vector<double> values(nMuons);
+
+      auto evaluate([&]() {
+          for (unsigned iM(0); iM != nMuons; ++iM) {
+            try {
+              values[iM] = corrections[iF](muons[iM]);
+            }
+            catch (std::exception&) {
+              values[iM] = -1.;
+            }
+          }
+        });
+
+      double t(timeCalls(_opts.timing ? 20 : 1, evaluate) / nMuons);
+
+      double sum(0.);
+      for (unsigned iM(0); iM != nMuons; ++iM) {
+        if (iM < nStored)
+          _results[key("roccor.%s.%02u", names[iF], iM)] = values[iM];
+        if (std::isfinite(values[iM]))
+          sum += values[iM];
+      }
+      _results[key("roccor.%s.sum", names[iF])] = sum;
+
+      _report << std::setw(24) << names[iF] << std::fixed << std::setprecision(3) << std::setw(12) << t << " us" << std::endl;
+      _report << std::defaultfloat;
+    }
+  }
+
+  void
+  runMVA(Options const& _opts, Results& _results, std::ostream& _report, unsigned&)
+  {
+    panda::BoostedBtaggingMVACalculator calculator;
+    calculator.initialize("BDT", _opts.data + "/BoostedSVDoubleCA15_withSubjet_v4.weights.xml");
+
+    auto&& inputs(makeMVAInputs(nMVA, 27182));
+
+    std::vector<double> values(nMVA);
+    auto evaluate([&]() {
+        for (unsigned iS(0); iS != nMVA; ++iS) {
+          auto& x(inputs[iS]);
+          values[iS] = calculator.mvaValue(x[0], x[1], x[2], x[3], x[4], x[5], x[6], x[7], x[8], x[9], x[10], x[11], x[12], x[13], x[14], x[15],
+                                           x[16], x[17], x[18], x[19], x[20], x[21], x[22], x[23], x[24], x[25], x[26], x[27], x[28], x[29],
+                                           x[30], x[31], x[32]);
+        }
+      });
+
+    double t(timeCalls(_opts.timing ? 20 : 1, evaluate) / nMVA);
+
+    double sum(0.);
+    for (unsigned iS(0); iS != nMVA; ++iS) {
+      if (iS < nStored)
+        _results[key("mva.%02u", iS)] = values[iS];
+      sum += values[iS];
+    }
+    _results["mva.sum"] = sum;
+
+    _report << std::endl << "BoostedBtaggingMVACalculator, time per jet (" << nMVA << " input sets)" << std::endl;
+    _report << std::setw(24) << "mvaValue" << std::fixed << std::setprecision(3) << std::setw(12) << t << " us" << std::endl;
+    _report << std::defaultfloat;
+  }
+
+  Results
+  readReference(std::string const& _path)
+  {
+    std::ifstream input(_path);
+    if (!input.is_open())
+      throw std::runtime_error("Cannot open reference file " + _path);
+
+    Results reference;
+    std::string line;
+    while (std::getline(input, line)) {
+      if (line.empty() || line[0] == '#')
+        continue;
+
+      std::istringstream ss(line);
+      std::string name;
+      double value;
+      if (!(ss >> name >> value))
+        throw std::runtime_error("Malformed line in " + _path + ": " + line);
+
+      reference[name] = value;
+    }
+
+    return reference;
+  }
+
+  void
+  writeReference(std::string const& _path, Results const& _results)
+  {
+    // keep the leading comments of an existing file, which say where the values come from
+    std::vector<std::string> comments;
+    std::ifstream input(_path);
+    std::string line;
+    while (std::getline(input, line) && !line.empty() && line[0] == '#')
+      comments.push_back(line);
+    input.close();
+
+    if (comments.empty())
+      comments.push_back("# Reference values of testPandaUtilities; regenerate with testPandaUtilities --update");
+
+    std::ofstream output(_path);
+    if (!output.is_open())
+      throw std::runtime_error("Cannot write reference file " + _path);
+
+    for (auto& comment : comments)
+      output << comment << std::endl;
+    output << std::setprecision(17);
+    for (auto& r : _results)
+      output << r.first << " " << r.second << std::endl;
+  }
+
+  unsigned
+  compare(Results const& _results, Results const& _reference)
+  {
+    unsigned nFailed(0);
+
+    for (auto& r : _results) {
+      auto refItr(_reference.find(r.first));
+      if (refItr == _reference.end()) {
+        std::cerr << "FAIL " << r.first << ": no reference value (a new value is added with --update)" << std::endl;
+        ++nFailed;
+        continue;
+      }
+
+      double value(r.second);
+      double ref(refItr->second);
+      bool same(std::isnan(value) ? std::isnan(ref) : std::abs(value - ref) <= relTolerance * std::max(std::abs(value), std::abs(ref)) + absTolerance);
+      if (!same) {
+        std::cerr << "FAIL " << r.first << ": " << std::setprecision(10) << value << " (reference " << ref << ")" << std::endl;
+        ++nFailed;
+      }
+    }
+
+    for (auto& ref : _reference) {
+      if (_results.count(ref.first) == 0) {
+        std::cerr << "FAIL " << ref.first << ": in the reference but not computed" << std::endl;
+        ++nFailed;
+      }
+    }
+
+    std::cout << std::endl << "Compared " << _results.size() << " values with the reference: " << nFailed << " failures" << std::endl;
+
+    return nFailed;
+  }
+
+}
+
+int
+main(int argc, char** argv)
+{
+  Options opts;
+
+  char const* cmsswBase(std::getenv("CMSSW_BASE"));
+  std::string packageDir(cmsswBase ? std::string(cmsswBase) + "/src/PandaProd/Utilities" : std::string("."));
+  opts.reference = packageDir + "/test/testPandaUtilities_reference.txt";
+  opts.data = packageDir + "/data";
+
+  for (int iA(1); iA < argc; ++iA) {
+    std::string arg(argv[iA]);
+    if (arg == "--update")
+      opts.update = true;
+    else if (arg == "--no-timing")
+      opts.timing = false;
+    else if (arg == "--reference" && iA + 1 < argc)
+      opts.reference = argv[++iA];
+    else if (arg == "--data" && iA + 1 < argc)
+      opts.data = argv[++iA];
+    else {
+      std::cerr << "Usage: " << argv[0] << " [--update] [--no-timing] [--reference FILE] [--data DIR]" << std::endl;
+      return 2;
+    }
+  }
+
+  Results results;
+  unsigned nFailed(0);
+
+  try {
+    runECF(opts, results, std::cout, nFailed);
+    runHTT(opts, results, std::cout, nFailed);
+    runRoccoR(opts, results, std::cout, nFailed);
+    runMVA(opts, results, std::cout, nFailed);
+
+    if (opts.update) {
+      writeReference(opts.reference, results);
+      std::cout << std::endl << "Wrote " << results.size() << " values to " << opts.reference << std::endl;
+    }
+    else
+      nFailed += compare(results, readReference(opts.reference));
+  }
+  catch (std::exception& ex) {
+    std::cerr << "ERROR " << ex.what() << std::endl;
+    return 1;
+  }
+
+  if (nFailed != 0) {
+    std::cerr << nFailed << " checks failed" << std::endl;
+    return 1;
+  }
+
+  return 0;
+}